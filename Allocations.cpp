@@ -0,0 +1,60 @@
+#include "Allocations.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+std::atomic<uint64_t> allocations(0);
+
+uint64_t allocation_count() {
+	return allocations.load(std::memory_order_relaxed);
+}
+
+// The array, nothrow and sized forms of new and delete forward to these by default. The aligned forms, used for any type
+// aligned above the default (PositionState, the accumulators), do not, so they are replaced as well.
+void* operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (size == 0) { size = 1; }
+	if (void* memory = std::malloc(size)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	size_t align = static_cast<size_t>(alignment);
+	size = (std::max<size_t>(size, 1) + align - 1) / align * align; // aligned_alloc wants a whole number of alignments
+#if defined(_MSC_VER)
+	void* memory = _aligned_malloc(size, align);
+#else
+	void* memory = std::aligned_alloc(align, size);
+#endif
+	if (memory) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+#if defined(_MSC_VER)
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept {
+	operator delete(memory, alignment);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "stdint.h"
+
+// Number of heap allocations (calls to the global operator new) made so far by the whole program, on every thread.
+// Counted by replacing the global operator new, at the cost of one relaxed atomic increment per allocation.
+uint64_t allocation_count();
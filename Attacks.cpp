@@ -0,0 +1,89 @@
+#include "Attacks.h"
+#include <cstdlib>
+
+bool on_board(int file, int row) {
+	return file >= 0 && file < 8 && row >= 0 && row < 8;
+}
+
+// rows count down the board like the square indices do: row 0 is the eighth rank
+uint64_t leaper_attacks(unsigned int sq, const int (*steps)[2], int count) {
+	uint64_t attacks = 0;
+	int file = sq % 8, row = sq / 8;
+	for (int i = 0; i < count; ++i) {
+		if (on_board(file + steps[i][0], row + steps[i][1])) {
+			attacks |= 1ULL << ((row + steps[i][1]) * 8 + file + steps[i][0]);
+		}
+	}
+	return attacks;
+}
+
+uint64_t ray_attacks(unsigned int sq, uint64_t occupied, const int (*steps)[2]) {
+	uint64_t attacks = 0;
+	for (int i = 0; i < 4; ++i) {
+		int file = sq % 8 + steps[i][0], row = sq / 8 + steps[i][1];
+		for (; on_board(file, row); file += steps[i][0], row += steps[i][1]) {
+			uint64_t bit = 1ULL << (row * 8 + file);
+			attacks |= bit;
+			if (occupied & bit) { break; }
+		}
+	}
+	return attacks;
+}
+
+const int KNIGHT_STEPS[8][2] = { {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2} };
+const int KING_STEPS[8][2] = { {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1} };
+const int PAWN_STEPS[2][2][2] = { { {-1, -1}, {1, -1} }, { {-1, 1}, {1, 1} } }; // white pawns capture towards row 0
+const int BISHOP_STEPS[4][2] = { {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+const int ROOK_STEPS[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+
+AttackTables::AttackTables() {
+	for (unsigned int sq = 0; sq < 64; ++sq) {
+		pawn[WHITE][sq] = leaper_attacks(sq, PAWN_STEPS[WHITE], 2);
+		pawn[BLACK][sq] = leaper_attacks(sq, PAWN_STEPS[BLACK], 2);
+		knight[sq] = leaper_attacks(sq, KNIGHT_STEPS, 8);
+		king[sq] = leaper_attacks(sq, KING_STEPS, 8);
+	}
+}
+
+const AttackTables attack_tables;
+
+uint64_t bishop_attacks(unsigned int sq, uint64_t occupied) {
+	return ray_attacks(sq, occupied, BISHOP_STEPS);
+}
+
+uint64_t rook_attacks(unsigned int sq, uint64_t occupied) {
+	return ray_attacks(sq, occupied, ROOK_STEPS);
+}
+
+uint64_t piece_attacks(Colors color, Types type, unsigned int sq, uint64_t occupied) {
+	switch (type) {
+	case PAWN: return attack_tables.pawn[color][sq];
+	case KNIGHT: return attack_tables.knight[sq];
+	case BISHOP: return bishop_attacks(sq, occupied);
+	case ROOK: return rook_attacks(sq, occupied);
+	case QUEEN: return bishop_attacks(sq, occupied) | rook_attacks(sq, occupied);
+	case KING: return attack_tables.king[sq];
+	default: return 0;
+	}
+}
+
+// The pieces in `pieces` (all of one color, `color`) that attack sq, given the occupancy
+uint64_t attackers_of(unsigned int sq, Colors color, const std::array<uint64_t, 6>& pieces, uint64_t occupied) {
+	uint64_t diagonal = pieces[BISHOP] | pieces[QUEEN], straight = pieces[ROOK] | pieces[QUEEN];
+	return (attack_tables.pawn[!color][sq] & pieces[PAWN])
+		| (attack_tables.knight[sq] & pieces[KNIGHT])
+		| (attack_tables.king[sq] & pieces[KING])
+		| (diagonal ? bishop_attacks(sq, occupied) & diagonal : 0)
+		| (straight ? rook_attacks(sq, occupied) & straight : 0);
+}
+
+uint64_t squares_between(unsigned int a, unsigned int b) {
+	int rows = int(b / 8) - int(a / 8), files = int(b % 8) - int(a % 8);
+	if (a == b || (rows != 0 && files != 0 && std::abs(rows) != std::abs(files))) {
+		return 0;
+	}
+	int step = (rows > 0 ? 8 : rows < 0 ? -8 : 0) + (files > 0 ? 1 : files < 0 ? -1 : 0);
+	uint64_t between = 0;
+	for (int sq = int(a) + step; sq != int(b); sq += step) { between |= 1ULL << sq; }
+	return between;
+}
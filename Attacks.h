@@ -0,0 +1,29 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include "stdint.h"
+#include "Colors.h"
+#include "Types.h"
+
+// Attack sets as plain bitboards in the engine's square order (bit 0 is a8, bit 63 is h1), for code that needs to know what
+// attacks a square without generating moves. Leaper attacks come from tables, slider attacks walk the rays over the occupancy.
+struct AttackTables {
+	std::array<std::array<uint64_t, 64>, 2> pawn; // indexed [color][square index], the squares a pawn there captures on
+	std::array<uint64_t, 64> knight;
+	std::array<uint64_t, 64> king;
+
+	AttackTables();
+};
+
+extern const AttackTables attack_tables;
+
+uint64_t bishop_attacks(unsigned int sq, uint64_t occupied);
+uint64_t rook_attacks(unsigned int sq, uint64_t occupied);
+uint64_t piece_attacks(Colors color, Types type, unsigned int sq, uint64_t occupied); // for any type but NONE
+uint64_t squares_between(unsigned int a, unsigned int b); // strictly between two squares on a rank, file or diagonal, 0 if they share none
+uint64_t attackers_of(unsigned int sq, Colors color, const std::array<uint64_t, 6>& pieces, uint64_t occupied); // pieces holds color's pieces by type
+
+inline unsigned int lowest_square(uint64_t bb) { // bb must not be empty
+	return static_cast<unsigned int>(std::bitset<64>((bb & (~bb + 1)) - 1).count()); // same trick as Square::convert_to_index
+}
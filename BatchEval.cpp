@@ -0,0 +1,288 @@
+#include "BatchEval.h"
+#include "Evaluation.h"
+#include "Pawns.h"
+#include "Search.h"
+#include "Attacks.h"
+#include "Parallel.h"
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BATCH_AVX2
+#endif
+
+const size_t SEARCH_JOB = 64; // positions per parallel job in batch_search
+
+void PositionBatch::clear() {
+	for (auto& color : pieces) {
+		for (auto& boards : color) { boards.clear(); }
+	}
+	turns.clear();
+	castling.clear();
+	ep_squares.clear();
+	ply_clocks.clear();
+	move_numbers.clear();
+	count = 0;
+}
+
+void PositionBatch::reserve(size_t positions) {
+	size_t padded = (positions + BATCH_BLOCK - 1) / BATCH_BLOCK * BATCH_BLOCK;
+	for (auto& color : pieces) {
+		for (auto& boards : color) { boards.reserve(padded); }
+	}
+	turns.reserve(positions);
+	castling.reserve(positions);
+	ep_squares.reserve(positions);
+	ply_clocks.reserve(positions);
+	move_numbers.reserve(positions);
+}
+
+bool PositionBatch::add(const PackedPosition& packed) {
+	std::array<std::array<uint64_t, 6>, 2> boards = {};
+	unsigned int piece = 0;
+	for (uint64_t occupied = packed.occupancy; occupied; occupied &= occupied - 1, ++piece) {
+		if (piece == 32) { return false; }
+		unsigned int nibble = (packed.pieces[piece / 2] >> (4 * (piece % 2))) & 0xF, type = nibble & 7;
+		if (type > KING) { return false; }
+		boards[nibble >> 3][type] |= occupied & (~occupied + 1);
+	}
+	for (int color = 0; color < 2; ++color) {
+		uint64_t king = boards[color][KING];
+		if (king == 0 || (king & (king - 1)) != 0) { return false; }
+	}
+
+	if (count % BATCH_BLOCK == 0) { // open a new block
+		for (auto& color : pieces) {
+			for (auto& array : color) { array.resize(count + BATCH_BLOCK, 0); }
+		}
+	}
+	for (int color = 0; color < 2; ++color) {
+		for (int type = 0; type < 6; ++type) { pieces[color][type][count] = boards[color][type]; }
+	}
+	turns.push_back(static_cast<uint8_t>((packed.state & 1) ? BLACK : WHITE));
+	castling.push_back(static_cast<uint8_t>((packed.state >> 1) & 0xF));
+	ep_squares.push_back(packed.ep_square);
+	ply_clocks.push_back(packed.ply_clock);
+	move_numbers.push_back(packed.move_number);
+	++count;
+	return true;
+}
+
+bool PositionBatch::add(Position& pos) {
+	PackedPosition packed;
+	return pos.pack(packed) && add(packed);
+}
+
+bool PositionBatch::add(std::string_view fen) {
+	return scratch.parse_fen(fen) == FEN_OK && add(scratch);
+}
+
+void PositionBatch::get(size_t index, PackedPosition& packed) const {
+	packed = PackedPosition();
+	for (int color = 0; color < 2; ++color) {
+		for (int type = 0; type < 6; ++type) { packed.occupancy |= pieces[color][type][index]; }
+	}
+	unsigned int piece = 0;
+	for (uint64_t occupied = packed.occupancy; occupied; occupied &= occupied - 1, ++piece) {
+		uint64_t bit = occupied & (~occupied + 1);
+		for (int color = 0; color < 2; ++color) {
+			for (int type = 0; type < 6; ++type) {
+				if (pieces[color][type][index] & bit) {
+					packed.pieces[piece / 2] |= static_cast<uint8_t>(((color << 3) | type) << (4 * (piece % 2)));
+				}
+			}
+		}
+	}
+	packed.state = static_cast<uint8_t>((turns[index] == BLACK ? 1 : 0) | (castling[index] << 1));
+	packed.ep_square = ep_squares[index];
+	packed.ply_clock = ply_clocks[index];
+	packed.move_number = move_numbers[index];
+}
+
+// Material and piece-square sums from white's point of view for the block of positions starting at first. The AVX2 kernel
+// walks the squares occupied in any position of the block and adds the square's value to every position that has the
+// piece there, four positions to a register. The scalar one walks each position's own pieces.
+void block_material(const PositionBatch& batch, size_t first, std::array<int, BATCH_BLOCK>& mg, std::array<int, BATCH_BLOCK>& eg) {
+#if defined(BATCH_AVX2)
+	static_assert(BATCH_BLOCK == 8, "the kernel holds a block in two registers");
+	__m256i mg_low = _mm256_setzero_si256(), mg_high = _mm256_setzero_si256();
+	__m256i eg_low = _mm256_setzero_si256(), eg_high = _mm256_setzero_si256();
+	for (int c = 0; c < 2; ++c) {
+		Colors color = static_cast<Colors>(c);
+		for (int t = 0; t < 6; ++t) {
+			Types type = static_cast<Types>(t);
+			const uint64_t* boards = batch.get_pieces(color, type) + first;
+			__m256i low = _mm256_loadu_si256((const __m256i*)boards), high = _mm256_loadu_si256((const __m256i*)(boards + 4));
+			uint64_t any = boards[0] | boards[1] | boards[2] | boards[3] | boards[4] | boards[5] | boards[6] | boards[7];
+			for (; any; any &= any - 1) {
+				unsigned int sq = lowest_square(any);
+				__m256i bit = _mm256_set1_epi64x(int64_t(uint64_t(1) << sq));
+				__m256i mg_weight = _mm256_set1_epi64x(mg_value(color, type, sq)), eg_weight = _mm256_set1_epi64x(eg_value(color, type, sq));
+				__m256i in_low = _mm256_cmpeq_epi64(_mm256_and_si256(low, bit), bit), in_high = _mm256_cmpeq_epi64(_mm256_and_si256(high, bit), bit);
+				mg_low = _mm256_add_epi64(mg_low, _mm256_and_si256(in_low, mg_weight));
+				mg_high = _mm256_add_epi64(mg_high, _mm256_and_si256(in_high, mg_weight));
+				eg_low = _mm256_add_epi64(eg_low, _mm256_and_si256(in_low, eg_weight));
+				eg_high = _mm256_add_epi64(eg_high, _mm256_and_si256(in_high, eg_weight));
+			}
+		}
+	}
+	alignas(32) std::array<int64_t, BATCH_BLOCK> mg_sums, eg_sums;
+	_mm256_store_si256((__m256i*)mg_sums.data(), mg_low);
+	_mm256_store_si256((__m256i*)(mg_sums.data() + 4), mg_high);
+	_mm256_store_si256((__m256i*)eg_sums.data(), eg_low);
+	_mm256_store_si256((__m256i*)(eg_sums.data() + 4), eg_high);
+	for (size_t i = 0; i < BATCH_BLOCK; ++i) {
+		mg[i] = static_cast<int>(mg_sums[i]);
+		eg[i] = static_cast<int>(eg_sums[i]);
+	}
+#else
+	mg.fill(0);
+	eg.fill(0);
+	for (int c = 0; c < 2; ++c) {
+		Colors color = static_cast<Colors>(c);
+		for (int t = 0; t < 6; ++t) {
+			Types type = static_cast<Types>(t);
+			const uint64_t* boards = batch.get_pieces(color, type) + first;
+			for (size_t i = 0; i < BATCH_BLOCK; ++i) {
+				for (uint64_t bb = boards[i]; bb; bb &= bb - 1) {
+					unsigned int sq = lowest_square(bb);
+					mg[i] += mg_value(color, type, sq);
+					eg[i] += eg_value(color, type, sq);
+				}
+			}
+		}
+	}
+#endif
+}
+
+void batch_evaluate(const PositionBatch& batch, std::vector<int>& scores, unsigned int threads) {
+	scores.resize(batch.size());
+	size_t blocks = (batch.size() + BATCH_BLOCK - 1) / BATCH_BLOCK;
+	parallel_for(blocks, threads, [&](size_t block) {
+		size_t first = block * BATCH_BLOCK, last = std::min(batch.size(), first + BATCH_BLOCK);
+		std::array<int, BATCH_BLOCK> mg, eg;
+		block_material(batch, first, mg, eg);
+
+		PawnEntry pawns;
+		for (size_t i = first; i < last; ++i) {
+			int phase = 0;
+			for (int type = KNIGHT; type <= QUEEN; ++type) {
+				uint64_t both = batch.get_pieces(WHITE, static_cast<Types>(type))[i] | batch.get_pieces(BLACK, static_cast<Types>(type))[i];
+				phase += phase_weights[type] * Bitboard(both).popcount();
+			}
+			phase = std::min(phase, MAX_PHASE);
+
+			compute_pawns(batch.get_pieces(WHITE, PAWN)[i], batch.get_pieces(BLACK, PAWN)[i], pawns);
+			std::array<unsigned int, 2> kings = { lowest_square(batch.get_pieces(WHITE, KING)[i]), lowest_square(batch.get_pieces(BLACK, KING)[i]) };
+			size_t j = i - first;
+			int score = (mg[j] * phase + eg[j] * (MAX_PHASE - phase)) / MAX_PHASE + pawn_score(pawns, kings, phase);
+			scores[i] = (batch.get_turn(i) == WHITE) ? score : -score;
+		}
+	});
+}
+
+void batch_search(const PositionBatch& batch, int depth, std::vector<int>& scores, unsigned int threads) {
+	scores.resize(batch.size());
+	size_t jobs = (batch.size() + SEARCH_JOB - 1) / SEARCH_JOB;
+	parallel_for(jobs, threads, [&](size_t job) {
+		Search search{ Position() };
+		search.get_tt().resize(1);
+		Position pos;
+		PackedPosition packed;
+		SearchLimits limits;
+		limits.depth = depth;
+		size_t last = std::min(batch.size(), (job + 1) * SEARCH_JOB);
+		for (size_t i = job * SEARCH_JOB; i < last; ++i) {
+			batch.get(i, packed);
+			if (!pos.unpack(packed)) { // a board that loads into the batch but is not a legal position, e.g. the side not to move in check
+				scores[i] = 0;
+				continue;
+			}
+			search.clear();
+			search.set_position(pos);
+			scores[i] = search.think(limits).score;
+		}
+	});
+}
+
+int eval_main(int argc, char* argv[]) {
+	const char* usage = "usage: eval <fens.txt | positions.bin> [depth <n>] [threads <n>]";
+	if (argc < 2) {
+		std::cerr << usage << std::endl;
+		return 2;
+	}
+	int depth = 0;
+	unsigned int threads = 1;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		std::string option = argv[i];
+		bool valid = true;
+		if (option == "depth") { valid = parse_number(argv[i + 1], depth); }
+		else if (option == "threads") { valid = parse_number(argv[i + 1], threads); }
+		if (!valid) {
+			std::cerr << usage << std::endl;
+			return 2;
+		}
+	}
+	depth = std::max(0, depth);
+	threads = std::max(1u, threads);
+
+	std::string path = argv[1];
+	PositionBatch batch;
+	uint64_t skipped = 0;
+	if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0) {
+		PackedPositionFile file;
+		if (!file.open(path)) {
+			std::cerr << "could not map " << path << std::endl;
+			return 2;
+		}
+		batch.reserve(file.size());
+		for (size_t i = 0; i < file.size(); ++i) {
+			if (!batch.add(file[i])) {
+				std::cerr << "record " << i << ": not a valid position" << std::endl;
+				++skipped;
+			}
+		}
+	}
+	else {
+		std::ifstream in(path);
+		if (!in) {
+			std::cerr << "could not open " << path << std::endl;
+			return 2;
+		}
+		std::string text;
+		unsigned int line = 0;
+		while (std::getline(in, text)) {
+			++line;
+			std::string_view fen(text);
+			fen = fen.substr(0, fen.find(';'));
+			while (!fen.empty() && (fen.back() == '\r' || fen.back() == ' ' || fen.back() == '\t')) { fen.remove_suffix(1); }
+			if (fen.empty() || fen[0] == '#') {
+				continue;
+			}
+			if (!batch.add(fen)) {
+				std::cerr << "line " << line << ": not a valid FEN" << std::endl;
+				++skipped;
+			}
+		}
+	}
+
+	std::vector<int> scores;
+	auto start = std::chrono::steady_clock::now();
+	if (depth > 0) {
+		batch_search(batch, depth, scores, threads);
+	}
+	else {
+		batch_evaluate(batch, scores, threads);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for (int score : scores) {
+		std::cout << score << '\n';
+	}
+	std::cerr << batch.size() << " positions scored in " << seconds << " s on " << threads << " threads, "
+		<< uint64_t(seconds > 0 ? batch.size() / seconds : 0) << " per second, " << skipped << " skipped" << std::endl;
+	return 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string_view>
+#include <cstddef>
+#include "stdint.h"
+#include "Colors.h"
+#include "Types.h"
+#include "Position.h"
+#include "PackedPosition.h"
+
+const size_t BATCH_BLOCK = 8; // positions the evaluation kernel works on at once
+
+// Many positions stored structure of arrays: for every color and piece type one array of bitboards running across the batch,
+// so that a term can be computed for a whole block of positions with the same instructions. The bitboard arrays are padded
+// with empty boards to a whole number of blocks.
+class PositionBatch {
+private:
+	std::array<std::array<std::vector<uint64_t>, 6>, 2> pieces; // [color][type][position]
+	std::vector<uint8_t> turns; // WHITE or BLACK
+	std::vector<uint8_t> castling; // Position's flag order (K, Q, k, q)
+	std::vector<uint8_t> ep_squares; // PackedPosition::NO_EP_SQUARE for none
+	std::vector<uint16_t> ply_clocks;
+	std::vector<uint16_t> move_numbers;
+	size_t count;
+	Position scratch; // parses FENs for add
+
+public:
+	PositionBatch() : count(0) {}
+
+	void clear();
+	void reserve(size_t positions);
+	bool add(const PackedPosition& packed); // decoded straight into the arrays, false if a side does not have exactly one king
+	bool add(Position& pos);
+	bool add(std::string_view fen); // false if the FEN does not parse
+
+	size_t size() const { return count; }
+	const uint64_t* get_pieces(Colors color, Types type) const { return pieces[color][type].data(); }
+	Colors get_turn(size_t index) const { return static_cast<Colors>(turns[index]); }
+	void get(size_t index, PackedPosition& packed) const; // the position back as a record, e.g. to set up a Position with unpack
+};
+
+// The hand written evaluation of every position in the batch, from the side to move's point of view: the same numbers
+// evaluate() gives without a network. Material and piece-square terms are summed a block at a time, with AVX2 when the build
+// targets it. The blocks are shared out over the threads.
+void batch_evaluate(const PositionBatch& batch, std::vector<int>& scores, unsigned int threads = 1);
+
+// A fixed depth search of every position, from the side to move's point of view. Every position is searched with cleared
+// tables, so the scores do not depend on the order of the batch or on the number of threads.
+void batch_search(const PositionBatch& batch, int depth, std::vector<int>& scores, unsigned int threads = 1);
+
+// eval <fens.txt | positions.bin> [depth <n>] [threads <n>]
+// Prints the score of every position in the file, one per line in file order: the static evaluation, or with depth, the
+// score of a search to that depth. Files ending in .bin are read as PackedPosition records, anything else as FENs.
+// Positions that do not load are reported on stderr and left out.
+int eval_main(int argc, char* argv[]);
@@ -0,0 +1,169 @@
+#include "Bench.h"
+#include "Position.h"
+#include "Search.h"
+#include "Notation.h"
+#include "Allocations.h"
+#include "Trace.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+const int BENCH_VERSION = 1; // bump whenever the positions or depths change, results are only comparable within a version
+const unsigned int MOVEGEN_CALLS = 2000; // move_gen calls per position per run
+
+const std::vector<BenchPosition> bench_positions = {
+	{ "startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4, 6 },
+	{ "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3, 5 },
+	{ "endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 8 },
+	{ "promotion", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 5 },
+	{ "promotion-check", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 5 },
+	{ "middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 3, 5 },
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// nearest rank percentile, p in [0, 100]
+double percentile(std::vector<double> samples, double p) {
+	if (samples.empty()) { return 0.0; }
+	std::sort(samples.begin(), samples.end());
+	size_t rank = size_t(std::ceil(p / 100.0 * samples.size()));
+	return samples[std::max<size_t>(rank, 1) - 1];
+}
+
+double per(double amount, double count) {
+	return count > 0 ? amount / count : 0.0;
+}
+
+int bench_main(int argc, char* argv[]) {
+	unsigned int runs = 5;
+	std::string out_path, trace_path;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string option = argv[i];
+		if (option == "runs") {
+			if (!parse_number(argv[i + 1], runs)) {
+				std::cerr << "usage: bench [runs <n>] [out <file.json>] [trace <file.json>]" << std::endl;
+				return 2;
+			}
+			runs = std::max(1u, runs);
+		}
+		else if (option == "out") { out_path = argv[i + 1]; }
+		else if (option == "trace") { trace_path = argv[i + 1]; }
+	}
+
+	std::ostringstream json;
+	json << std::fixed << std::setprecision(3);
+	json << "{\n  \"version\": " << BENCH_VERSION << ",\n  \"runs\": " << runs << ",\n";
+	uint64_t total_perft_nodes = 0, total_search_nodes = 0;
+	double total_perft_seconds = 0, total_search_seconds = 0;
+
+	// perft: whole tree walks, one sample per run
+	json << "  \"perft\": [\n";
+	for (size_t p = 0; p < bench_positions.size(); ++p) {
+		const BenchPosition& bench = bench_positions[p];
+		std::vector<double> samples;
+		uint64_t nodes = 0, allocations = 0;
+		for (unsigned int run = 0; run < runs; ++run) {
+			Position pos(bench.fen);
+			pos.reserve_history(bench.perft_depth);
+			uint64_t allocations_before = allocation_count();
+			auto start = std::chrono::steady_clock::now();
+			nodes = pos.perft(bench.perft_depth);
+			samples.push_back(seconds_since(start));
+			allocations += allocation_count() - allocations_before;
+		}
+		double median = percentile(samples, 50);
+		total_perft_nodes += nodes;
+		total_perft_seconds += median;
+		json << "    { \"name\": \"" << bench.name << "\", \"depth\": " << bench.perft_depth << ", \"nodes\": " << nodes
+			<< ", \"median_ms\": " << median * 1000 << ", \"p99_ms\": " << percentile(samples, 99) * 1000
+			<< ", \"nps\": " << uint64_t(per(double(nodes), median)) << ", \"allocs_per_node\": " << per(double(allocations), double(nodes) * runs)
+			<< " }" << (p + 1 < bench_positions.size() ? "," : "") << "\n";
+	}
+	json << "  ],\n";
+
+	// move generation alone: every call is a sample
+	json << "  \"movegen\": [\n";
+	for (size_t p = 0; p < bench_positions.size(); ++p) {
+		const BenchPosition& bench = bench_positions[p];
+		Position pos(bench.fen);
+		MoveList list;
+		std::vector<double> samples;
+		samples.reserve(size_t(runs) * MOVEGEN_CALLS);
+		uint64_t moves = 0, allocations = 0;
+		double seconds = 0;
+		for (unsigned int run = 0; run < runs; ++run) {
+			uint64_t allocations_before = allocation_count();
+			for (unsigned int call = 0; call < MOVEGEN_CALLS; ++call) {
+				auto start = std::chrono::steady_clock::now();
+				pos.move_gen(list);
+				moves += list.size();
+				samples.push_back(seconds_since(start));
+				seconds += samples.back();
+			}
+			allocations += allocation_count() - allocations_before;
+		}
+		double calls = double(runs) * MOVEGEN_CALLS;
+		json << "    { \"name\": \"" << bench.name << "\", \"moves\": " << uint64_t(moves / calls) << ", \"calls\": " << uint64_t(calls)
+			<< ", \"median_ns\": " << percentile(samples, 50) * 1e9 << ", \"p99_ns\": " << percentile(samples, 99) * 1e9
+			<< ", \"calls_per_second\": " << uint64_t(per(calls, seconds)) << ", \"allocs_per_call\": " << per(double(allocations), calls)
+			<< " }" << (p + 1 < bench_positions.size() ? "," : "") << "\n";
+	}
+	json << "  ],\n";
+
+	// search from a cold start (fresh tables) every run, so that every run searches the same tree
+	json << "  \"search\": [\n";
+	for (size_t p = 0; p < bench_positions.size(); ++p) {
+		const BenchPosition& bench = bench_positions[p];
+		std::vector<double> samples;
+		uint64_t nodes = 0, allocations = 0;
+		Move best_move;
+		for (unsigned int run = 0; run < runs; ++run) {
+			Search search{ Position(bench.fen) };
+			SearchLimits limits;
+			limits.depth = bench.search_depth;
+			uint64_t allocations_before = allocation_count();
+			auto start = std::chrono::steady_clock::now();
+			SearchResult result = search.think(limits);
+			samples.push_back(seconds_since(start));
+			allocations += allocation_count() - allocations_before;
+			nodes = result.nodes;
+			best_move = result.best_move;
+		}
+		double median = percentile(samples, 50);
+		total_search_nodes += nodes;
+		total_search_seconds += median;
+		json << "    { \"name\": \"" << bench.name << "\", \"depth\": " << bench.search_depth << ", \"nodes\": " << nodes
+			<< ", \"best_move\": \"" << move_to_uci(best_move) << "\""
+			<< ", \"median_ms\": " << median * 1000 << ", \"p99_ms\": " << percentile(samples, 99) * 1000
+			<< ", \"nps\": " << uint64_t(per(double(nodes), median)) << ", \"allocs_per_node\": " << per(double(allocations), double(nodes) * runs)
+			<< " }" << (p + 1 < bench_positions.size() ? "," : "") << "\n";
+	}
+	json << "  ],\n";
+
+	json << "  \"total\": { \"perft_nodes\": " << total_perft_nodes << ", \"perft_nps\": " << uint64_t(per(double(total_perft_nodes), total_perft_seconds))
+		<< ", \"search_nodes\": " << total_search_nodes << ", \"search_nps\": " << uint64_t(per(double(total_search_nodes), total_search_seconds)) << " }\n";
+	json << "}\n";
+
+	if (!trace_path.empty() && !write_chrome_trace(trace_path)) {
+		std::cerr << "could not write " << trace_path << std::endl;
+	}
+
+	if (out_path.empty()) {
+		std::cout << json.str();
+	}
+	else {
+		std::ofstream file(out_path);
+		if (!file) {
+			std::cerr << "could not write " << out_path << std::endl;
+			return 2;
+		}
+		file << json.str();
+	}
+	return 0;
+}
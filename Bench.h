@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// A fixed position the benchmark runs through perft, move generation and search
+struct BenchPosition {
+	std::string name;
+	std::string fen;
+	unsigned int perft_depth;
+	int search_depth;
+};
+
+extern const std::vector<BenchPosition> bench_positions;
+
+// bench [runs <n>] [out <file.json>] [trace <file.json>]
+// Runs every bench position through perft, a move_gen loop and a fixed depth search, on one thread, and writes the median and
+// 99th percentile timings, nodes per second and allocations per node as JSON. The node counts double as a regression check.
+// In builds with ENABLE_TRACE, trace writes the spans recorded during the run as a Chrome trace.
+int bench_main(int argc, char* argv[]);
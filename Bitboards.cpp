@@ -126,9 +126,9 @@ bool Square::on_promote_rank(Colors turn) {
 }
 
 unsigned int Square::convert_to_index() {
-	unsigned int maxbit = 0;
-	while ((*this >> (maxbit + 1)) != 0) maxbit++;
-	return maxbit;
+	// the bits below a single set bit are all set by subtracting one, so counting them gives the index.
+	// (shifting right until empty needs a shift by 64 for H1, which is undefined and never terminates on x86)
+	return std::bitset<64>(this->bitboard - 1).count();
 }
 
 std::string Square::p2an() {
@@ -179,7 +179,7 @@ int Square::direction_from(Square from)
 			dr = dr / sm;
 		}
 	}
-	return dr * 8 + df;
+	return df - dr * 8; // moving up a rank moves towards A8, which is a lower index
 }
 
 
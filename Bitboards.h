@@ -8,6 +8,9 @@
 #include "Utils.h"
 class Square;
 
+extern std::array<uint64_t, 8> rank_masks; // indexed 0 for the 1st rank to 7 for the 8th
+extern std::array<uint64_t, 8> file_masks; // indexed 0 for the A file to 7 for the H file
+
 class Bitboard {
 private:
 	uint64_t bitboard;
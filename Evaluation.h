@@ -0,0 +1,23 @@
+#pragma once
+
+#include <array>
+#include "Colors.h"
+#include "Types.h"
+
+class Position;
+class PawnTable;
+
+const int MAX_PHASE = 24; // game phase with every piece on the board, falls to 0 with only kings and pawns left
+
+// Material plus piece-square values, with separate middlegame and endgame weights.
+// Indexed [type][square] with the square index as white sees it (0 is A8), black pieces are looked up mirrored.
+extern std::array<std::array<int, 64>, 6> mg_table;
+extern std::array<std::array<int, 64>, 6> eg_table;
+extern const std::array<int, 6> phase_weights;
+
+int mg_value(Colors color, Types type, unsigned int index);
+int eg_value(Colors color, Types type, unsigned int index);
+
+// Tapered evaluation from the point of view of the side to move, in centipawns, or the network's evaluation when the position
+// has accumulators attached. Reads the scores that make_move keeps up to date and the cached pawn structure, so it costs almost nothing per node.
+int evaluate(Position& pos, PawnTable& pawn_table);
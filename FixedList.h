@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cassert>
+#include <algorithm>
+#include <initializer_list>
+#include <type_traits>
+#include <new>
+
+// A list with room for N elements inside the object itself, for scratch space on the search path: it never touches the heap,
+// and making one costs nothing, since the slots stay uninitialized until something is pushed into them. Only holds trivially
+// copyable types, so a whole list copies as plain memory.
+template <typename T, size_t N>
+class FixedList {
+private:
+	static_assert(std::is_trivially_copyable<T>::value, "elements are copied and dropped as plain memory");
+
+	alignas(T) unsigned char storage[N * sizeof(T)];
+	size_t count;
+
+public:
+	FixedList() : count(0) {}
+	FixedList(std::initializer_list<T> values) : count(0) {
+		for (const T& value : values) { push_back(value); }
+	}
+
+	T* begin() { return reinterpret_cast<T*>(storage); }
+	T* end() { return begin() + count; }
+	const T* begin() const { return reinterpret_cast<const T*>(storage); }
+	const T* end() const { return begin() + count; }
+	T& operator[](size_t index) { assert(index < count); return begin()[index]; }
+	const T& operator[](size_t index) const { assert(index < count); return begin()[index]; }
+	T& back() { assert(count > 0); return begin()[count - 1]; }
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	static constexpr size_t capacity() { return N; }
+
+	void clear() { count = 0; }
+	void push_back(const T& value) {
+		assert(count < N);
+		new (begin() + count) T(value);
+		++count;
+	}
+	void pop_back() { assert(count > 0); --count; }
+	void truncate(size_t size) { assert(size <= count); count = size; } // drops everything from index size on
+	T* erase(T* first, T* last) { // keeps the order of what is left, as std::vector::erase does
+		count = static_cast<size_t>(std::move(last, end(), first) - begin());
+		return first;
+	}
+};
@@ -0,0 +1,82 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : bytes(nullptr), length(0), file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr) {}
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	LARGE_INTEGER file_size;
+	if (file_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_handle, &file_size)) {
+		close();
+		return false;
+	}
+	if (file_size.QuadPart == 0) {
+		return true; // nothing to map
+	}
+
+	mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* view = mapping_handle ? MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view) {
+		close();
+		return false;
+	}
+	bytes = static_cast<const char*>(view);
+	length = size_t(file_size.QuadPart);
+	return true;
+}
+
+void MappedFile::close() {
+	if (bytes) { UnmapViewOfFile(bytes); }
+	if (mapping_handle) { CloseHandle(mapping_handle); }
+	if (file_handle != INVALID_HANDLE_VALUE) { CloseHandle(file_handle); }
+	bytes = nullptr;
+	length = 0;
+	mapping_handle = nullptr;
+	file_handle = INVALID_HANDLE_VALUE;
+}
+#else
+MappedFile::MappedFile() : bytes(nullptr), length(0), descriptor(-1) {}
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	descriptor = ::open(path.c_str(), O_RDONLY);
+	struct stat info;
+	if (descriptor < 0 || fstat(descriptor, &info) != 0) {
+		close();
+		return false;
+	}
+	if (info.st_size == 0) {
+		return true; // mmap refuses empty mappings
+	}
+
+	void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+	if (view == MAP_FAILED) {
+		close();
+		return false;
+	}
+	madvise(view, size_t(info.st_size), MADV_SEQUENTIAL);
+	bytes = static_cast<const char*>(view);
+	length = size_t(info.st_size);
+	return true;
+}
+
+void MappedFile::close() {
+	if (bytes) { munmap(const_cast<char*>(bytes), length); }
+	if (descriptor >= 0) { ::close(descriptor); }
+	bytes = nullptr;
+	length = 0;
+	descriptor = -1;
+}
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+// A whole file mapped read-only into memory (CreateFileMapping on Windows, mmap elsewhere). The pages are read in by the
+// operating system as they are touched, so even files much bigger than memory can be walked from start to end.
+class MappedFile {
+private:
+	const char* bytes;
+	size_t length;
+#ifdef _WIN32
+	void* file_handle;
+	void* mapping_handle;
+#else
+	int descriptor;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path); // an empty file opens with no data
+	void close();
+
+	const char* data() const { return bytes; }
+	size_t size() const { return length; }
+	std::string_view text() const { return std::string_view(bytes, length); }
+};
@@ -5,6 +5,7 @@
 #include "Colors.h"
 #include "Types.h"
 #include "SpecialMoves.h"
+#include "FixedList.h"
 
 class Move {
 private:
@@ -45,8 +46,18 @@ public:
 	Types get_capt_type() { return this->capt_type; }
 	Types get_promote_type() { return this->promote_type; }
 	SpecialMoves get_move_type() { return this->move_type; }
+	bool is_capture() { return this->capt_type != Types::NONE; }
+	bool is_null() { return this->type == Types::NONE; }
+
+	// two moves are the same if they move the same piece between the same squares (and promote to the same piece)
+	bool operator==(Move& rhs) { return this->from == rhs.from && this->to == rhs.to && this->type == rhs.type && this->promote_type == rhs.promote_type; }
+	bool operator!=(Move& rhs) { return !(*this == rhs); }
 
 };
 
+const size_t MAX_MOVES = 256; // more than the legal moves of any position, the most known is 218
+
+using MoveList = FixedList<Move, MAX_MOVES>; // what the search generates into, so that no node allocates
+
 Bitboard merge_moves(std::vector<Move> moves);
 std::ostream& operator<<(std::ostream& out, Move move);
\ No newline at end of file
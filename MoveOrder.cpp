@@ -0,0 +1,114 @@
+#include "MoveOrder.h"
+#include <cstdlib>
+#include <algorithm>
+
+void MoveOrder::clear() {
+	clear_killers();
+	for (auto& by_from : history) {
+		for (auto& by_to : by_from) {
+			by_to.fill(0);
+		}
+	}
+	for (auto& by_type : countermoves) {
+		for (auto& by_to : by_type) {
+			by_to.fill(Move());
+		}
+	}
+}
+
+void MoveOrder::clear_killers() {
+	for (auto& slots : killers) {
+		slots.fill(Move());
+	}
+}
+
+// MVV-LVA: capturing a more valuable piece is always tried first, and among captures of the same piece the least valuable attacker goes first.
+// Promotions are scored as if they captured the piece they promote to, so a queening push sorts with the queen captures.
+int MoveOrder::mvv_lva(Move& move) {
+	int victim = (move.get_capt_type() == NONE) ? -1 : int(move.get_capt_type());
+	if (move.get_move_type() == PROMOTION) {
+		victim += int(move.get_promote_type()) + 1;
+	}
+	return (victim + 1) * 8 - int(move.get_type());
+}
+
+int MoveOrder::history_score(Move& move) {
+	return history[move.get_color()][move.get_from().convert_to_index()][move.get_to().convert_to_index()];
+}
+
+bool MoveOrder::is_killer(Move& move, int ply) {
+	return move == killers[ply][0] || move == killers[ply][1];
+}
+
+void MoveOrder::score_moves(MoveList& moves, MoveScores& scores, Move hash_move, Move prev_move, int ply) {
+	Move counter;
+	if (!prev_move.is_null()) {
+		counter = countermoves[prev_move.get_color()][prev_move.get_type()][prev_move.get_to().convert_to_index()];
+	}
+
+	for (unsigned int i = 0; i < moves.size(); ++i) {
+		auto& move = moves[i];
+		if (move == hash_move) {
+			scores[i] = HASH_SCORE;
+		}
+		else if (move.is_capture() || (move.get_move_type() == PROMOTION && move.get_promote_type() == QUEEN)) {
+			scores[i] = CAPTURE_SCORE + mvv_lva(move);
+		}
+		else if (move == killers[ply][0]) {
+			scores[i] = KILLER_SCORE;
+		}
+		else if (move == killers[ply][1]) {
+			scores[i] = KILLER_SCORE - 1;
+		}
+		else if (move == counter) {
+			scores[i] = COUNTER_SCORE;
+		}
+		else if (move.get_move_type() == PROMOTION) { // underpromotions are almost never right, try them after everything else
+			scores[i] = -2 * HISTORY_MAX + int(move.get_promote_type());
+		}
+		else {
+			scores[i] = history_score(move);
+		}
+	}
+}
+
+// Selection sort one step at a time: brings the best scoring move at or after index to index and returns it.
+// A cutoff usually comes within the first few moves, so this beats sorting the whole list up front.
+Move MoveOrder::pick_next(MoveList& moves, MoveScores& scores, unsigned int index) {
+	unsigned int best = index;
+	for (unsigned int i = index + 1; i < moves.size(); ++i) {
+		if (scores[i] > scores[best]) {
+			best = i;
+		}
+	}
+	std::swap(moves[index], moves[best]);
+	std::swap(scores[index], scores[best]);
+	return moves[index];
+}
+
+// Gravity update: the bonus is scaled down as the entry approaches HISTORY_MAX, so scores saturate instead of overflowing
+// and old results fade as new ones come in.
+void MoveOrder::apply_gravity(int& entry, int bonus) {
+	entry += bonus - entry * std::abs(bonus) / HISTORY_MAX;
+}
+
+// Called when a quiet move causes a beta cutoff. Rewards the cutoff move and penalizes the quiet moves that were searched before it without success.
+void MoveOrder::update_quiet(Move& best, MoveList& tried_quiets, Move prev_move, int ply, int depth) {
+	int bonus = std::min(depth * depth, 400) * 32;
+
+	if (best != killers[ply][0]) {
+		killers[ply][1] = killers[ply][0];
+		killers[ply][0] = best;
+	}
+
+	apply_gravity(history[best.get_color()][best.get_from().convert_to_index()][best.get_to().convert_to_index()], bonus);
+	for (auto& quiet : tried_quiets) {
+		if (quiet != best) {
+			apply_gravity(history[quiet.get_color()][quiet.get_from().convert_to_index()][quiet.get_to().convert_to_index()], -bonus);
+		}
+	}
+
+	if (!prev_move.is_null()) {
+		countermoves[prev_move.get_color()][prev_move.get_type()][prev_move.get_to().convert_to_index()] = best;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include "Move.h"
+#include "Types.h"
+#include "Colors.h"
+
+const int MAX_PLY = 128; // deepest ply the search (and therefore the per-ply tables) will ever reach
+
+using MoveScores = std::array<int, MAX_MOVES>; // ordering scores, alongside a MoveList
+
+// Scores moves so that the search tries the most promising ones first.
+// Ordering, from first to last:
+//   1. the hash move (best move remembered from a previous search of this position)
+//   2. captures and queen promotions, by MVV-LVA (most valuable victim, least valuable attacker)
+//   3. the two killer moves for this ply (quiet moves that caused a beta cutoff in a sibling node)
+//   4. the countermove (quiet move that last refuted the opponent's previous move)
+//   5. every other quiet move, by its butterfly history score
+//   6. underpromotions that do not capture, which are almost never right
+class MoveOrder {
+private:
+	static const int HISTORY_MAX = 16384; // history scores are kept within [-HISTORY_MAX, HISTORY_MAX] by the gravity update
+
+	std::array<std::array<Move, 2>, MAX_PLY> killers; // two killer slots per ply, [0] is the most recent
+	std::array<std::array<std::array<int, 64>, 64>, 2> history; // butterfly table, indexed [color][from][to]
+	std::array<std::array<std::array<Move, 64>, 6>, 2> countermoves; // indexed [color][type][to] of the move being answered
+
+	void apply_gravity(int& entry, int bonus);
+
+public:
+	// Score tiers, the gaps between them are larger than any score within a tier.
+	static const int HASH_SCORE = 1 << 30;
+	static const int CAPTURE_SCORE = 1 << 24;
+	static const int KILLER_SCORE = 1 << 20;
+	static const int COUNTER_SCORE = KILLER_SCORE - 2;
+
+	MoveOrder() { clear(); }
+
+	void clear();
+	void clear_killers();
+	static int mvv_lva(Move& move);
+	int history_score(Move& move);
+	void score_moves(MoveList& moves, MoveScores& scores, Move hash_move, Move prev_move, int ply);
+	static Move pick_next(MoveList& moves, MoveScores& scores, unsigned int index);
+	void update_quiet(Move& best, MoveList& tried_quiets, Move prev_move, int ply, int depth);
+	bool is_killer(Move& move, int ply);
+};
@@ -0,0 +1,281 @@
+#include "Nnue.h"
+#include "Position.h"
+#include "MoveOrder.h"
+#include <fstream>
+#include <memory>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NNUE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NNUE_SSE2
+#endif
+
+// Network file layout, all values little endian:
+//   "NNUE", uint32 version, uint32 inputs, uint32 half dims, uint32 hidden1, uint32 hidden2
+//   followed by every field of Network in declaration order
+const char NETWORK_MAGIC[4] = { 'N', 'N', 'U', 'E' };
+const uint32_t NETWORK_VERSION = 1;
+
+std::unique_ptr<Network> loaded_network;
+
+// SIMD kernels, each with a scalar fallback for targets without AVX2 or SSE2.
+
+// acc[i] += row[i] for NNUE_HALF_DIMS values
+void vec_add(int16_t* acc, const int16_t* row) {
+#if defined(NNUE_AVX2)
+	for (int i = 0; i < NNUE_HALF_DIMS; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+		__m256i r = _mm256_loadu_si256((const __m256i*)(row + i));
+		_mm256_storeu_si256((__m256i*)(acc + i), _mm256_add_epi16(a, r));
+	}
+#elif defined(NNUE_SSE2)
+	for (int i = 0; i < NNUE_HALF_DIMS; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(acc + i));
+		__m128i r = _mm_loadu_si128((const __m128i*)(row + i));
+		_mm_storeu_si128((__m128i*)(acc + i), _mm_add_epi16(a, r));
+	}
+#else
+	for (int i = 0; i < NNUE_HALF_DIMS; ++i) { acc[i] += row[i]; }
+#endif
+}
+
+// acc[i] -= row[i] for NNUE_HALF_DIMS values
+void vec_sub(int16_t* acc, const int16_t* row) {
+#if defined(NNUE_AVX2)
+	for (int i = 0; i < NNUE_HALF_DIMS; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+		__m256i r = _mm256_loadu_si256((const __m256i*)(row + i));
+		_mm256_storeu_si256((__m256i*)(acc + i), _mm256_sub_epi16(a, r));
+	}
+#elif defined(NNUE_SSE2)
+	for (int i = 0; i < NNUE_HALF_DIMS; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(acc + i));
+		__m128i r = _mm_loadu_si128((const __m128i*)(row + i));
+		_mm_storeu_si128((__m128i*)(acc + i), _mm_sub_epi16(a, r));
+	}
+#else
+	for (int i = 0; i < NNUE_HALF_DIMS; ++i) { acc[i] -= row[i]; }
+#endif
+}
+
+// out[i] = clamp(in[i], 0, NNUE_CLIP_MAX) for NNUE_HALF_DIMS values, narrowed to 8 bits
+void clipped_relu_16(const int16_t* in, uint8_t* out) {
+#if defined(NNUE_AVX2)
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i clip = _mm256_set1_epi8(NNUE_CLIP_MAX);
+	for (int i = 0; i < NNUE_HALF_DIMS; i += 32) {
+		__m256i lo = _mm256_loadu_si256((const __m256i*)(in + i));
+		__m256i hi = _mm256_loadu_si256((const __m256i*)(in + i + 16));
+		__m256i packed = _mm256_packs_epi16(lo, hi); // saturates to [-128, 127], but interleaves the 128 bit lanes...
+		packed = _mm256_permute4x64_epi64(packed, 0b11011000); // ...so put them back in order
+		packed = _mm256_min_epi8(_mm256_max_epi8(packed, zero), clip);
+		_mm256_storeu_si256((__m256i*)(out + i), packed);
+	}
+#elif defined(NNUE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (int i = 0; i < NNUE_HALF_DIMS; i += 16) {
+		__m128i lo = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(in + i + 8));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_max_epi16(lo, zero), _mm_max_epi16(hi, zero))); // 127 fits, so saturating to 255 is enough
+	}
+	for (int i = 0; i < NNUE_HALF_DIMS; ++i) { out[i] = std::min<uint8_t>(out[i], NNUE_CLIP_MAX); }
+#else
+	for (int i = 0; i < NNUE_HALF_DIMS; ++i) { out[i] = uint8_t(std::max<int>(0, std::min<int>(NNUE_CLIP_MAX, in[i]))); }
+#endif
+}
+
+// sum of in[i] * weights[i] over n values, n a multiple of 32
+int32_t dot_product(const uint8_t* in, const int8_t* weights, int n) {
+#if defined(NNUE_AVX2)
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum = _mm256_setzero_si256();
+	for (int i = 0; i < n; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(in + i));
+		__m256i w = _mm256_loadu_si256((const __m256i*)(weights + i));
+		__m256i pairs = _mm256_maddubs_epi16(a, w); // inputs are at most 127, so the pairwise sums can not saturate
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, ones));
+	}
+	__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0b01001110));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0b10110001));
+	return _mm_cvtsi128_si32(half);
+#elif defined(NNUE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum = _mm_setzero_si128();
+	for (int i = 0; i < n; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i w = _mm_loadu_si128((const __m128i*)(weights + i));
+		// widen to 16 bits: zero extend the inputs, sign extend the weights
+		__m128i a_lo = _mm_unpacklo_epi8(a, zero), a_hi = _mm_unpackhi_epi8(a, zero);
+		__m128i w_lo = _mm_srai_epi16(_mm_unpacklo_epi8(w, w), 8), w_hi = _mm_srai_epi16(_mm_unpackhi_epi8(w, w), 8);
+		sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_madd_epi16(a_lo, w_lo), _mm_madd_epi16(a_hi, w_hi)));
+	}
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b01001110));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b10110001));
+	return _mm_cvtsi128_si32(sum);
+#else
+	int32_t sum = 0;
+	for (int i = 0; i < n; ++i) { sum += int32_t(in[i]) * int32_t(weights[i]); }
+	return sum;
+#endif
+}
+
+// one dense layer followed by a clipped ReLU
+void dense_layer(const uint8_t* in, int n_in, const int8_t* weights, const int32_t* biases, uint8_t* out, int n_out) {
+	for (int o = 0; o < n_out; ++o) {
+		int32_t sum = biases[o] + dot_product(in, weights + o * n_in, n_in);
+		out[o] = uint8_t(std::max(0, std::min(NNUE_CLIP_MAX, sum >> NNUE_WEIGHT_SHIFT)));
+	}
+}
+
+template <typename T> bool read_values(std::ifstream& file, std::vector<T>& values, size_t count) {
+	values.resize(count);
+	file.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+	return bool(file);
+}
+
+template <typename T> bool write_values(std::ofstream& file, const std::vector<T>& values) {
+	file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	return bool(file);
+}
+
+bool Network::load(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	char magic[4];
+	uint32_t header[5];
+
+	file.read(magic, 4);
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!file || !std::equal(magic, magic + 4, NETWORK_MAGIC)) { return false; }
+	if (header[0] != NETWORK_VERSION || header[1] != NNUE_INPUTS || header[2] != NNUE_HALF_DIMS || header[3] != NNUE_HIDDEN1 || header[4] != NNUE_HIDDEN2) {
+		return false; // a network for some other architecture
+	}
+
+	return read_values(file, ft_biases, NNUE_HALF_DIMS)
+		&& read_values(file, ft_weights, size_t(NNUE_INPUTS) * NNUE_HALF_DIMS)
+		&& read_values(file, h1_biases, NNUE_HIDDEN1)
+		&& read_values(file, h1_weights, size_t(NNUE_HIDDEN1) * 2 * NNUE_HALF_DIMS)
+		&& read_values(file, h2_biases, NNUE_HIDDEN2)
+		&& read_values(file, h2_weights, size_t(NNUE_HIDDEN2) * NNUE_HIDDEN1)
+		&& file.read(reinterpret_cast<char*>(&out_bias), sizeof(out_bias))
+		&& read_values(file, out_weights, NNUE_HIDDEN2);
+}
+
+bool Network::save(const std::string& path) {
+	std::ofstream file(path, std::ios::binary);
+	uint32_t header[5] = { NETWORK_VERSION, NNUE_INPUTS, NNUE_HALF_DIMS, NNUE_HIDDEN1, NNUE_HIDDEN2 };
+
+	file.write(NETWORK_MAGIC, 4);
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	return write_values(file, ft_biases) && write_values(file, ft_weights)
+		&& write_values(file, h1_biases) && write_values(file, h1_weights)
+		&& write_values(file, h2_biases) && write_values(file, h2_weights)
+		&& file.write(reinterpret_cast<const char*>(&out_bias), sizeof(out_bias))
+		&& write_values(file, out_weights);
+}
+
+bool load_network(const std::string& path) {
+	std::unique_ptr<Network> network(new Network());
+	if (!network->load(path)) {
+		return false;
+	}
+	loaded_network = std::move(network);
+	return true;
+}
+
+Network* get_network() {
+	return loaded_network.get();
+}
+
+// Both the king and the piece square are mirrored for black, and the piece color is relative to the perspective,
+// so a position and its color-flipped twin produce the same features.
+unsigned int nnue_feature(Colors perspective, unsigned int king_index, Colors color, Types type, unsigned int index) {
+	unsigned int flip = (perspective == WHITE) ? 0 : 56;
+	unsigned int piece = unsigned(type) * 2 + (color == perspective ? 0 : 1);
+	return ((king_index ^ flip) * 10 + piece) * 64 + (index ^ flip);
+}
+
+AccumulatorStack::AccumulatorStack(const Network& network) : network(network), frames(MAX_PLY + 8), top(0) {}
+
+void AccumulatorStack::add_feature(Accumulator& acc, Colors perspective, unsigned int feature) {
+	vec_add(acc.values[perspective].data(), &network.ft_weights[size_t(feature) * NNUE_HALF_DIMS]);
+}
+
+void AccumulatorStack::sub_feature(Accumulator& acc, Colors perspective, unsigned int feature) {
+	vec_sub(acc.values[perspective].data(), &network.ft_weights[size_t(feature) * NNUE_HALF_DIMS]);
+}
+
+void AccumulatorStack::push() {
+	assert(top + 1 < frames.size());
+	frames[top + 1] = frames[top];
+	++top;
+	frames[top].dirty = { false, false };
+}
+
+void AccumulatorStack::pop() {
+	assert(top > 0);
+	--top;
+}
+
+// Called for every piece that is put on or taken off the board. A king move changes every feature of its own perspective,
+// so that perspective is only marked and gets rebuilt in refresh_dirty once the move is complete.
+void AccumulatorStack::update(Position& pos, Colors color, Types type, unsigned int index, bool added) {
+	Accumulator& acc = frames[top];
+	if (type == KING) {
+		acc.dirty[color] = true;
+		return;
+	}
+	for (int p = 0; p < 2; ++p) {
+		auto perspective = static_cast<Colors>(p);
+		if (acc.dirty[perspective]) { continue; }
+		unsigned int king_index = Square(pos.get_pieces(perspective, KING)).convert_to_index();
+		unsigned int feature = nnue_feature(perspective, king_index, color, type, index);
+		added ? add_feature(acc, perspective, feature) : sub_feature(acc, perspective, feature);
+	}
+}
+
+void AccumulatorStack::refresh(Position& pos, Colors perspective) {
+	Accumulator& acc = frames[top];
+	unsigned int king_index = Square(pos.get_pieces(perspective, KING)).convert_to_index();
+
+	std::copy(network.ft_biases.begin(), network.ft_biases.end(), acc.values[perspective].begin());
+	for (int c = 0; c < 2; ++c) {
+		for (int t = PAWN; t < KING; ++t) {
+			auto color = static_cast<Colors>(c);
+			auto type = static_cast<Types>(t);
+			Bitboard pieces = pos.get_pieces(color, type);
+			while (!pieces.is_empty()) {
+				add_feature(acc, perspective, nnue_feature(perspective, king_index, color, type, pieces.pop_occupied().convert_to_index()));
+			}
+		}
+	}
+	acc.dirty[perspective] = false;
+}
+
+void AccumulatorStack::refresh_dirty(Position& pos) {
+	for (int p = 0; p < 2; ++p) {
+		if (frames[top].dirty[p]) { refresh(pos, static_cast<Colors>(p)); }
+	}
+}
+
+// Side to move's accumulator goes first, so the network always sees the position from the side to move.
+int nnue_evaluate(Position& pos, AccumulatorStack& stack) {
+	const Network& network = stack.get_network();
+	Accumulator& acc = stack.current();
+	Colors turn = pos.get_turn();
+
+	alignas(32) uint8_t transformed[2 * NNUE_HALF_DIMS];
+	alignas(32) uint8_t hidden1[NNUE_HIDDEN1];
+	alignas(32) uint8_t hidden2[NNUE_HIDDEN2];
+
+	clipped_relu_16(acc.values[turn].data(), transformed);
+	clipped_relu_16(acc.values[!turn].data(), transformed + NNUE_HALF_DIMS);
+	dense_layer(transformed, 2 * NNUE_HALF_DIMS, network.h1_weights.data(), network.h1_biases.data(), hidden1, NNUE_HIDDEN1);
+	dense_layer(hidden1, NNUE_HIDDEN1, network.h2_weights.data(), network.h2_biases.data(), hidden2, NNUE_HIDDEN2);
+
+	int32_t output = network.out_bias + dot_product(hidden2, network.out_weights.data(), NNUE_HIDDEN2);
+	return output / NNUE_OUTPUT_SCALE;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include "stdint.h"
+#include "Colors.h"
+#include "Types.h"
+
+class Position;
+
+// Efficiently updatable neural network evaluation.
+//
+// Input features are HalfKP: for each side's point of view, one feature per (own king square, piece square, piece type and color)
+// for every piece except the kings. Squares are mirrored vertically for black, so both sides see the board from their own side.
+// The first layer (the feature transformer) is kept as an accumulator per side, which make_move updates by adding and subtracting
+// the weight rows of the few features that changed. Only a king move needs that side's accumulator rebuilt.
+//
+//   feature transformer  40960 -> 256 per side, int16
+//   hidden layer 1       512 -> 32, int8 weights, clipped ReLU
+//   hidden layer 2       32 -> 32, int8 weights, clipped ReLU
+//   output               32 -> 1
+const int NNUE_INPUTS = 64 * 10 * 64; // king square * (5 piece types * 2 colors) * piece square
+const int NNUE_HALF_DIMS = 256;
+const int NNUE_HIDDEN1 = 32;
+const int NNUE_HIDDEN2 = 32;
+const int NNUE_WEIGHT_SHIFT = 6; // hidden layer weights are fixed point with 6 fractional bits
+const int NNUE_OUTPUT_SCALE = 16; // network output units per centipawn
+const int NNUE_CLIP_MAX = 127;
+
+struct Network {
+	std::vector<int16_t> ft_biases; // [NNUE_HALF_DIMS]
+	std::vector<int16_t> ft_weights; // [NNUE_INPUTS][NNUE_HALF_DIMS]
+	std::vector<int32_t> h1_biases; // [NNUE_HIDDEN1]
+	std::vector<int8_t> h1_weights; // [NNUE_HIDDEN1][2 * NNUE_HALF_DIMS]
+	std::vector<int32_t> h2_biases; // [NNUE_HIDDEN2]
+	std::vector<int8_t> h2_weights; // [NNUE_HIDDEN2][NNUE_HIDDEN1]
+	int32_t out_bias;
+	std::vector<int8_t> out_weights; // [NNUE_HIDDEN2]
+
+	bool load(const std::string& path);
+	bool save(const std::string& path);
+};
+
+struct alignas(32) Accumulator {
+	std::array<std::array<int16_t, NNUE_HALF_DIMS>, 2> values; // indexed [perspective]
+	std::array<bool, 2> dirty; // this perspective's king moved, rebuild it once the move is complete
+};
+
+// One accumulator per ply of the current line. Owned by a search thread and attached to its Position,
+// which pushes a frame in make_move and pops it in undo.
+class AccumulatorStack {
+private:
+	const Network& network;
+	std::vector<Accumulator> frames;
+	unsigned int top;
+
+	void add_feature(Accumulator& acc, Colors perspective, unsigned int feature);
+	void sub_feature(Accumulator& acc, Colors perspective, unsigned int feature);
+
+public:
+	AccumulatorStack(const Network& network);
+
+	void push();
+	void pop();
+	void update(Position& pos, Colors color, Types type, unsigned int index, bool added);
+	void refresh(Position& pos, Colors perspective);
+	void refresh_dirty(Position& pos);
+	Accumulator& current() { return frames[top]; }
+	const Network& get_network() { return network; }
+};
+
+bool load_network(const std::string& path);
+Network* get_network(); // nullptr until a network has been loaded
+
+unsigned int nnue_feature(Colors perspective, unsigned int king_index, Colors color, Types type, unsigned int index);
+int nnue_evaluate(Position& pos, AccumulatorStack& stack);
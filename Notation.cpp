@@ -0,0 +1,232 @@
+#include "Notation.h"
+#include "Attacks.h"
+#include <algorithm>
+
+const char PIECE_LETTERS[] = "PNBRQK";
+
+size_t move_to_uci(Move move, char* buffer, size_t size) {
+	char text[MAX_UCI_LENGTH];
+	size_t n = 0;
+	if (move.is_null()) {
+		std::copy_n("0000", 4, text);
+		n = 4;
+	}
+	else {
+		unsigned int from = move.get_from().convert_to_index(), to = move.get_to().convert_to_index();
+		text[n++] = static_cast<char>('a' + from % 8);
+		text[n++] = static_cast<char>('8' - from / 8);
+		text[n++] = static_cast<char>('a' + to % 8);
+		text[n++] = static_cast<char>('8' - to / 8);
+		if (move.get_move_type() == PROMOTION) {
+			text[n++] = "pnbrqk"[move.get_promote_type()];
+		}
+	}
+
+	if (n + 1 > size) {
+		return 0;
+	}
+	std::copy_n(text, n, buffer);
+	buffer[n] = '\0';
+	return n;
+}
+
+std::string move_to_uci(Move move) {
+	char text[MAX_UCI_LENGTH];
+	size_t length = move_to_uci(move, text, sizeof(text));
+	return std::string(text, length);
+}
+
+// Compares squares and promotion piece directly instead of formatting every legal move
+bool parse_uci_move(Position& pos, std::string_view text, Move& move) {
+	if (text.size() < 4 || text.size() > 5) {
+		return false;
+	}
+	for (int i = 0; i < 4; i += 2) {
+		if (text[i] < 'a' || text[i] > 'h' || text[i + 1] < '1' || text[i + 1] > '8') { return false; }
+	}
+	unsigned int from = ('8' - text[1]) * 8 + (text[0] - 'a'), to = ('8' - text[3]) * 8 + (text[2] - 'a');
+	int promote_type = NONE;
+	if (text.size() == 5) {
+		const char* letter = std::find(PIECE_LETTERS, PIECE_LETTERS + 6, static_cast<char>(text[4] & ~0x20)); // uppercase
+		if (letter == PIECE_LETTERS + 6) { return false; }
+		promote_type = static_cast<int>(letter - PIECE_LETTERS);
+	}
+
+	for (auto& legal : pos.move_gen()) {
+		if (legal.get_from().convert_to_index() == from && legal.get_to().convert_to_index() == to && legal.get_promote_type() == promote_type) {
+			move = legal;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Pieces of one side, by type, as plain bitboards
+std::array<uint64_t, 6> side_pieces(Position& pos, Colors color) {
+	std::array<uint64_t, 6> pieces;
+	for (int type = 0; type < 6; ++type) { pieces[type] = pos.get_pieces(color, static_cast<Types>(type)).get_u64(); }
+	return pieces;
+}
+
+size_t move_to_san(Position& pos, Move move, char* buffer, size_t size) {
+	char san[MAX_SAN_LENGTH];
+	size_t n = 0;
+
+	if (move.is_null()) {
+		std::copy_n("--", 2, san); // the usual PGN extension for a null move
+		n = 2;
+	}
+	else {
+		Colors us = move.get_color(), them = !us;
+		Types type = move.get_type();
+		unsigned int from = move.get_from().convert_to_index(), to = move.get_to().convert_to_index();
+		uint64_t from_bit = 1ULL << from, to_bit = 1ULL << to, occupied = pos.get_occupied().get_u64();
+		std::array<uint64_t, 6> ours = side_pieces(pos, us), theirs = side_pieces(pos, them);
+
+		if (move.get_move_type() == CASTLE) {
+			n = (to % 8 == 2) ? 5 : 3;
+			std::copy_n("O-O-O", n, san);
+		}
+		else {
+			if (type != PAWN) {
+				san[n++] = PIECE_LETTERS[type];
+			}
+			if (type != PAWN && type != KING) {
+				// other pieces of the same type that could also go to `to`: the attacks are symmetric, so look from `to`.
+				// A pinned one does not count, so drop any whose move would leave the king attacked.
+				uint64_t others = piece_attacks(us, type, to, occupied) & ours[type] & ~from_bit;
+				unsigned int king_sq = lowest_square(ours[KING]);
+				bool same_file = false, same_row = false, ambiguous = false;
+				for (uint64_t rest = others; rest; rest &= rest - 1) {
+					unsigned int other = lowest_square(rest);
+					std::array<uint64_t, 6> remaining = theirs;
+					for (auto& bb : remaining) { bb &= ~to_bit; }
+					if (attackers_of(king_sq, them, remaining, (occupied & ~(1ULL << other)) | to_bit)) {
+						continue;
+					}
+					ambiguous = true;
+					same_file |= other % 8 == from % 8;
+					same_row |= other / 8 == from / 8;
+				}
+				if (ambiguous && (!same_file || same_row)) { san[n++] = static_cast<char>('a' + from % 8); }
+				if (ambiguous && same_file) { san[n++] = static_cast<char>('8' - from / 8); }
+			}
+			if (move.is_capture()) {
+				if (type == PAWN) { san[n++] = static_cast<char>('a' + from % 8); }
+				san[n++] = 'x';
+			}
+			san[n++] = static_cast<char>('a' + to % 8);
+			san[n++] = static_cast<char>('8' - to / 8);
+			if (move.get_move_type() == PROMOTION) {
+				san[n++] = '=';
+				san[n++] = PIECE_LETTERS[move.get_promote_type()];
+			}
+		}
+
+		// check: play the move on the bitboards and look at the other king, which catches discovered checks as well
+		uint64_t after = (occupied & ~from_bit) | to_bit;
+		ours[type] &= ~from_bit;
+		ours[move.get_move_type() == PROMOTION ? move.get_promote_type() : type] |= to_bit;
+		if (move.get_move_type() == EN_PASSANT) {
+			after &= ~move.get_special().get_u64();
+		}
+		else if (move.get_move_type() == CASTLE) {
+			uint64_t rook_from = move.get_special().get_u64(), rook_to = (to % 8 == 2) ? to_bit << 1 : to_bit >> 1;
+			after = (after & ~rook_from) | rook_to;
+			ours[ROOK] = (ours[ROOK] & ~rook_from) | rook_to;
+		}
+		if (attackers_of(lowest_square(theirs[KING]), us, ours, after)) {
+			pos.make_move(move);
+			bool mate = !pos.has_legal_move();
+			pos.undo();
+			san[n++] = mate ? '#' : '+';
+		}
+	}
+
+	if (n + 1 > size) {
+		return 0;
+	}
+	std::copy_n(san, n, buffer);
+	buffer[n] = '\0';
+	return n;
+}
+
+std::string move_to_san(Position& pos, Move move) {
+	char san[MAX_SAN_LENGTH];
+	size_t length = move_to_san(pos, move, san, sizeof(san));
+	return std::string(san, length);
+}
+
+int san_piece_type(char c) {
+	switch (c) {
+	case 'N': return KNIGHT;
+	case 'B': return BISHOP;
+	case 'R': return ROOK;
+	case 'Q': return QUEEN;
+	case 'K': return KING;
+	default: return NONE;
+	}
+}
+
+bool parse_san(Position& pos, std::string_view san, Move& move) {
+	while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) { san.remove_suffix(1); }
+	if (san.empty()) {
+		return false;
+	}
+
+	// castling, also written with zeros
+	if (san[0] == 'O' || san[0] == '0') {
+		bool queenside;
+		if (san == "O-O" || san == "0-0") { queenside = false; }
+		else if (san == "O-O-O" || san == "0-0-0") { queenside = true; }
+		else { return false; }
+		for (auto& legal : pos.move_gen()) {
+			if (legal.get_move_type() == CASTLE && (legal.get_to().convert_to_index() % 8 == 2) == queenside) {
+				move = legal;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	int type = PAWN;
+	if (san_piece_type(san[0]) != NONE) {
+		type = san_piece_type(san[0]);
+		san.remove_prefix(1);
+	}
+
+	int promote_type = NONE;
+	if (san.size() >= 2 && san_piece_type(san.back()) != NONE) {
+		promote_type = san_piece_type(san.back());
+		san.remove_suffix(san[san.size() - 2] == '=' ? 2 : 1);
+	}
+
+	// the destination comes last, anything before it is disambiguation (a file, a rank or both) or the capture mark
+	if (san.size() < 2) {
+		return false;
+	}
+	char to_file = san[san.size() - 2], to_rank = san[san.size() - 1];
+	if (to_file < 'a' || to_file > 'h' || to_rank < '1' || to_rank > '8') {
+		return false;
+	}
+	unsigned int to_index = ('8' - to_rank) * 8 + (to_file - 'a');
+	int from_file = -1, from_rank = -1;
+	for (char c : san.substr(0, san.size() - 2)) {
+		if (c >= 'a' && c <= 'h') { from_file = c - 'a'; }
+		else if (c >= '1' && c <= '8') { from_rank = '8' - c; }
+		else if (c != 'x' && c != ':' && c != '-') { return false; }
+	}
+
+	int matches = 0;
+	for (auto& legal : pos.move_gen()) {
+		unsigned int from_index = legal.get_from().convert_to_index();
+		if (legal.get_type() != type || legal.get_to().convert_to_index() != to_index || legal.get_move_type() == CASTLE
+			|| legal.get_promote_type() != promote_type
+			|| (from_file >= 0 && int(from_index % 8) != from_file) || (from_rank >= 0 && int(from_index / 8) != from_rank)) {
+			continue;
+		}
+		move = legal;
+		++matches;
+	}
+	return matches == 1;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include "Position.h"
+#include "Move.h"
+
+const size_t MAX_UCI_LENGTH = 6; // "e7e8q" and the terminating null
+const size_t MAX_SAN_LENGTH = 8; // "Qa1xb2+", "exd8=Q#" and the terminating null
+
+// Long algebraic notation as UCI uses it: "e2e4", "e7e8q", castling as the king's move, "0000" for the null move.
+// The buffer versions write a null terminated string and return its length, or 0 if it does not fit.
+size_t move_to_uci(Move move, char* buffer, size_t size);
+std::string move_to_uci(Move move);
+bool parse_uci_move(Position& pos, std::string_view text, Move& move); // false unless text is a legal move in pos
+
+// Standard algebraic notation for a legal move in pos, before it is made ("Nbd7", "exd6", "e8=Q+", "O-O-O#").
+// Disambiguation and the check mark come from attack bitboards, only a checking move has to look for replies to tell mate.
+size_t move_to_san(Position& pos, Move move, char* buffer, size_t size);
+std::string move_to_san(Position& pos, Move move);
+
+// Resolves a move in standard algebraic notation against the legal moves of the position.
+// Check and annotation suffixes are ignored, and so is a missing or superfluous capture mark. Returns false if no legal
+// move, or more than one, fits.
+bool parse_san(Position& pos, std::string_view san, Move& move);
@@ -0,0 +1,119 @@
+#include "PackedPosition.h"
+#include "Position.h"
+#include "Parallel.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+bool PackedPositionFile::open(const std::string& path) {
+	close();
+	if (!file.open(path) || file.size() % sizeof(PackedPosition) != 0) {
+		close();
+		return false;
+	}
+	records = reinterpret_cast<const PackedPosition*>(file.data());
+	count = file.size() / sizeof(PackedPosition);
+	return true;
+}
+
+void PackedPositionFile::close() {
+	file.close();
+	records = nullptr;
+	count = 0;
+}
+
+int pack_main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "usage: pack <fens.txt> <out.bin>" << std::endl;
+		return 2;
+	}
+	std::ifstream in(argv[1]);
+	std::ofstream out(argv[2], std::ios::binary);
+	if (!in || !out) {
+		std::cerr << "could not open " << (!in ? argv[1] : argv[2]) << std::endl;
+		return 2;
+	}
+
+	std::string text;
+	unsigned int line = 0;
+	uint64_t written = 0, skipped = 0;
+	Position pos;
+	PackedPosition packed;
+	while (std::getline(in, text)) {
+		++line;
+		std::string_view fen(text);
+		fen = fen.substr(0, fen.find(';'));
+		while (!fen.empty() && (fen.back() == '\r' || fen.back() == ' ' || fen.back() == '\t')) { fen.remove_suffix(1); }
+		if (fen.empty() || fen[0] == '#') {
+			continue;
+		}
+		FenErrors error = pos.parse_fen(fen);
+		if (error != FEN_OK || !pos.pack(packed)) {
+			std::cerr << "line " << line << ": " << (error != FEN_OK ? fen_error_message(error) : "too many pieces to pack") << std::endl;
+			++skipped;
+			continue;
+		}
+		out.write(reinterpret_cast<const char*>(&packed), sizeof(packed));
+		++written;
+	}
+	std::cout << written << " positions packed, " << skipped << " skipped" << std::endl;
+	return out ? 0 : 2;
+}
+
+int unpack_main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "usage: unpack <in.bin> [threads <n>]" << std::endl;
+		return 2;
+	}
+	unsigned int threads = 0;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		if (std::string(argv[i]) == "threads") {
+			if (!parse_number(argv[i + 1], threads)) {
+				std::cerr << "usage: unpack <in.bin> [threads <n>]" << std::endl;
+				return 2;
+			}
+			threads = std::max(1u, threads); // 0 is kept for printing the positions instead of timing the decode
+		}
+	}
+
+	PackedPositionFile file;
+	if (!file.open(argv[1])) {
+		std::cerr << "could not map " << argv[1] << std::endl;
+		return 2;
+	}
+
+	if (threads == 0) {
+		Position pos;
+		char fen[MAX_FEN_LENGTH];
+		for (size_t i = 0; i < file.size(); ++i) {
+			if (!pos.unpack(file[i])) {
+				std::cerr << "record " << i << ": not a valid position" << std::endl;
+				continue;
+			}
+			pos.to_fen(fen, sizeof(fen));
+			std::cout << fen << '\n';
+		}
+		return 0;
+	}
+
+	// decode only, in one contiguous slice of the mapping per job
+	const size_t SLICE = 1 << 16;
+	std::atomic<uint64_t> invalid(0);
+	auto start = std::chrono::steady_clock::now();
+	parallel_for((file.size() + SLICE - 1) / SLICE, threads, [&](size_t slice) {
+		Position pos;
+		uint64_t bad = 0;
+		size_t last = std::min(file.size(), (slice + 1) * SLICE);
+		for (size_t i = slice * SLICE; i < last; ++i) {
+			bad += !pos.unpack(file[i]);
+		}
+		invalid += bad;
+	});
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << file.size() << " positions decoded in " << seconds << " s on " << threads << " threads, "
+		<< uint64_t(seconds > 0 ? file.size() / seconds : 0) << " per second, " << invalid << " invalid" << std::endl;
+	return 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <type_traits>
+#include "stdint.h"
+#include "MappedFile.h"
+
+// A position in 32 bytes, for datasets too big to keep as FEN text. Written and read with Position::pack / Position::unpack.
+//
+// The occupied squares are a bitboard in the engine's square order (bit 0 is a8, bit 63 is h1). The pieces on them follow in
+// the same order, one nibble each, low nibble first: bit 3 is the color (set for black) and the low three bits the type
+// (PAWN ... KING), so 32 pieces fit. Records are stored in host byte order, which is little endian on every target we build.
+struct PackedPosition {
+	uint64_t occupancy;
+	uint8_t pieces[16];
+	uint8_t state; // bit 0 set when black is to move, bits 1-4 the castling rights in Position's flag order (K, Q, k, q), bits 5-6 a game result
+	uint8_t ep_square; // square index of the en passant square, NO_EP_SQUARE for none
+	uint16_t ply_clock; // plys since the last capture or pawn move
+	uint16_t move_number; // full move number, as in FEN
+	int16_t label; // free for the dataset, e.g. a search score or a game result. pack writes 0, unpack ignores it
+
+	static const uint8_t NO_EP_SQUARE = 0xFF;
+
+	// The result of the game the position comes from, for datasets that record one, in state bits 5-6. pack writes
+	// RESULT_NONE, unpack ignores it
+	static const unsigned int RESULT_SHIFT = 5;
+	static const uint8_t RESULT_NONE = 0;
+	static const uint8_t RESULT_WHITE_WINS = 1;
+	static const uint8_t RESULT_DRAW = 2;
+	static const uint8_t RESULT_BLACK_WINS = 3;
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition records must stay 32 bytes, files depend on it");
+static_assert(std::is_trivially_copyable<PackedPosition>::value, "PackedPosition records are read straight out of mapped files");
+
+// A read-only file of PackedPosition records, memory mapped so that the records are used in place without being copied or
+// parsed. The records stay valid until the file is closed or the object is destroyed.
+class PackedPositionFile {
+private:
+	MappedFile file;
+	const PackedPosition* records;
+	size_t count;
+
+public:
+	PackedPositionFile() : records(nullptr), count(0) {}
+
+	bool open(const std::string& path); // false if the file cannot be mapped or its size is not a whole number of records. An empty file opens with no records
+	void close();
+
+	size_t size() const { return count; }
+	const PackedPosition& operator[](size_t index) const { return records[index]; }
+	const PackedPosition* begin() const { return records; }
+	const PackedPosition* end() const { return records + count; }
+};
+
+// pack <fens.txt> <out.bin>
+// Converts a file of FENs, one per line (anything after a ';' is ignored, so EPD works too), into PackedPosition records.
+int pack_main(int argc, char* argv[]);
+
+// unpack <in.bin> [threads <n>]
+// Maps a file of records and prints each one as a FEN, or with threads, only decodes them all in parallel and reports the rate.
+int unpack_main(int argc, char* argv[]);
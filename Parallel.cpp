@@ -0,0 +1,28 @@
+#include "Parallel.h"
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+void parallel_for(size_t count, unsigned int threads, const std::function<void(size_t)>& job) {
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t index = next++; index < count; index = next++) {
+			job(index);
+		}
+	};
+
+	threads = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+	std::vector<std::thread> pool;
+	for (unsigned int i = 1; i < threads; ++i) {
+		pool.emplace_back(worker);
+	}
+	worker(); // the calling thread is one of the workers
+	for (auto& thread : pool) {
+		thread.join();
+	}
+}
+
+unsigned int default_thread_count() {
+	return std::max(1u, std::thread::hardware_concurrency());
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Runs job(0) ... job(count - 1) on a fixed number of worker threads. Each worker takes the next index as soon as it is free,
+// so jobs should be ordered longest first when their sizes differ a lot. Returns once every job has finished.
+void parallel_for(size_t count, unsigned int threads, const std::function<void(size_t)>& job);
+
+unsigned int default_thread_count(); // one per hardware thread, at least one
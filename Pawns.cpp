@@ -0,0 +1,153 @@
+#include "Pawns.h"
+#include "Position.h"
+#include <algorithm>
+
+// All masks use the Bitboard layout: bit 0 is A8, each rank is one byte, so "up the board" for white is a right shift by 8.
+const int DOUBLED_MG = -10, DOUBLED_EG = -20;
+const int ISOLATED_MG = -5, ISOLATED_EG = -15;
+const int BACKWARD_MG = -8, BACKWARD_EG = -10;
+const std::array<int, 8> passed_mg = { 0, 5, 10, 15, 25, 40, 60, 0 }; // indexed by rank, relative to the pawn's color
+const std::array<int, 8> passed_eg = { 0, 10, 20, 35, 60, 90, 130, 0 };
+const std::array<int, 4> shield_bonus = { 0, 12, 6, 0 }; // for a shield pawn on the 2nd or 3rd rank in front of the king
+
+// all files next to each file
+std::array<uint64_t, 8> build_adjacent_files() {
+	std::array<uint64_t, 8> masks;
+	for (int file = 0; file < 8; ++file) {
+		masks[file] = (file > 0 ? file_masks[file - 1] : 0) | (file < 7 ? file_masks[file + 1] : 0);
+	}
+	return masks;
+}
+
+// every rank strictly in front of a rank, from the point of view of each color, indexed [color][rank]
+std::array<std::array<uint64_t, 8>, 2> build_forward_ranks() {
+	std::array<std::array<uint64_t, 8>, 2> masks;
+	for (int rank = 0; rank < 8; ++rank) {
+		masks[WHITE][rank] = 0;
+		masks[BLACK][rank] = 0;
+		for (int ahead = rank + 1; ahead < 8; ++ahead) { masks[WHITE][rank] |= rank_masks[ahead]; }
+		for (int ahead = rank - 1; ahead >= 0; --ahead) { masks[BLACK][rank] |= rank_masks[ahead]; }
+	}
+	return masks;
+}
+
+const std::array<uint64_t, 8> adjacent_files = build_adjacent_files();
+const std::array<std::array<uint64_t, 8>, 2> forward_ranks = build_forward_ranks();
+
+PawnTable::PawnTable(unsigned int size_log2) : entries(size_t(1) << size_log2), mask((uint64_t(1) << size_log2) - 1), probes(0), hits(0) {
+	clear();
+}
+
+void PawnTable::clear() {
+	for (auto& entry : entries) {
+		entry = PawnEntry();
+		entry.key = ~uint64_t(0); // no pawn configuration hashes to this in practice, unlike 0 which is the key of "no pawns"
+	}
+}
+
+PawnEntry& PawnTable::probe(Position& pos) {
+	uint64_t key = pos.get_pawn_key();
+	PawnEntry& entry = entries[key & mask];
+	++probes;
+	if (entry.key == key) {
+		++hits;
+	}
+	else {
+		compute(pos, entry);
+		entry.key = key;
+	}
+	return entry;
+}
+
+void PawnTable::compute(Position& pos, PawnEntry& entry) {
+	compute_pawns(pos.get_pieces(WHITE, PAWN).get_u64(), pos.get_pieces(BLACK, PAWN).get_u64(), entry);
+}
+
+void compute_pawns(uint64_t white_pawns, uint64_t black_pawns, PawnEntry& entry) {
+	std::array<uint64_t, 2> pawns = { white_pawns, black_pawns };
+	entry.mg_score = 0;
+	entry.eg_score = 0;
+
+	for (int c = 0; c < 2; ++c) {
+		auto color = static_cast<Colors>(c);
+		int sign = (color == WHITE) ? 1 : -1;
+		uint64_t own = pawns[color], enemy = pawns[!color];
+
+		for (int file = 0; file < 8; ++file) {
+			int count = Bitboard(own & file_masks[file]).popcount();
+			if (count > 1) {
+				entry.mg_score += sign * DOUBLED_MG * (count - 1);
+				entry.eg_score += sign * DOUBLED_EG * (count - 1);
+			}
+		}
+
+		Bitboard remaining = Bitboard(own);
+		while (!remaining.is_empty()) {
+			unsigned int index = remaining.pop_occupied().convert_to_index();
+			int file = index % 8;
+			int rank = 7 - int(index / 8);
+			int relative_rank = (color == WHITE) ? rank : 7 - rank;
+			uint64_t front = forward_ranks[color][rank];
+
+			bool isolated = (own & adjacent_files[file]) == 0;
+			bool passed = (enemy & (file_masks[file] | adjacent_files[file]) & front) == 0;
+
+			if (isolated) {
+				entry.mg_score += sign * ISOLATED_MG;
+				entry.eg_score += sign * ISOLATED_EG;
+			}
+			else {
+				// backward: every friendly pawn on the adjacent files is further up the board, and an enemy pawn guards the stop square
+				uint64_t behind_or_level = ~front & adjacent_files[file];
+				int stop_index = (color == WHITE) ? int(index) - 8 : int(index) + 8;
+				int stop_rank = (color == WHITE) ? rank + 1 : rank - 1;
+				if ((own & behind_or_level) == 0 && stop_index >= 0 && stop_index < 64) {
+					int enemy_rank = (color == WHITE) ? stop_rank + 1 : stop_rank - 1; // enemy pawns guarding the stop square sit one rank beyond it
+					if (enemy_rank >= 0 && enemy_rank < 8 && (enemy & adjacent_files[file] & rank_masks[enemy_rank]) != 0) {
+						entry.mg_score += sign * BACKWARD_MG;
+						entry.eg_score += sign * BACKWARD_EG;
+					}
+				}
+			}
+
+			if (passed) {
+				entry.mg_score += sign * passed_mg[relative_rank];
+				entry.eg_score += sign * passed_eg[relative_rank];
+			}
+		}
+
+		// pawn shield for every file the king could be on, so the entry stays valid wherever the king goes
+		for (int king_file = 0; king_file < 8; ++king_file) {
+			int bonus = 0;
+			uint64_t files = file_masks[king_file] | adjacent_files[king_file];
+			for (int relative_rank = 1; relative_rank <= 2; ++relative_rank) {
+				int rank = (color == WHITE) ? relative_rank : 7 - relative_rank;
+				bonus += shield_bonus[relative_rank] * Bitboard(own & files & rank_masks[rank]).popcount();
+			}
+			entry.shield[color][king_file] = int8_t(bonus);
+		}
+	}
+}
+
+int evaluate_pawns(Position& pos, PawnTable& table) {
+	PawnEntry& entry = table.probe(pos);
+	std::array<unsigned int, 2> kings = { Square(pos.get_pieces(WHITE, KING)).convert_to_index(), Square(pos.get_pieces(BLACK, KING)).convert_to_index() };
+	return pawn_score(entry, kings, std::min(pos.get_phase(), MAX_PHASE));
+}
+
+int pawn_score(const PawnEntry& entry, const std::array<unsigned int, 2>& kings, int phase) {
+	int mg = entry.mg_score;
+
+	// the shield only counts while the king is still on its first two ranks
+	for (int c = 0; c < 2; ++c) {
+		auto color = static_cast<Colors>(c);
+		unsigned int index = kings[color];
+		int rank = 7 - int(index / 8);
+		int relative_rank = (color == WHITE) ? rank : 7 - rank;
+		if (relative_rank <= 1) {
+			mg += ((color == WHITE) ? 1 : -1) * entry.shield[color][index % 8];
+		}
+	}
+
+	return (mg * phase + entry.eg_score * (MAX_PHASE - phase)) / MAX_PHASE;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include "stdint.h"
+#include "Colors.h"
+
+class Position;
+
+// Pawn structure scores for one pawn configuration, from white's point of view.
+struct PawnEntry {
+	uint64_t key; // pawn Zobrist key this entry was computed for
+	int mg_score; // doubled, isolated, backward and passed pawn terms
+	int eg_score;
+	std::array<std::array<int8_t, 8>, 2> shield; // middlegame pawn shield bonus, indexed [color][king file]
+};
+
+// Caches pawn structure evaluation by the position's pawn key. Pawns move rarely, so almost every probe is a hit.
+// Not thread safe, every search thread owns one.
+class PawnTable {
+private:
+	std::vector<PawnEntry> entries;
+	uint64_t mask;
+	uint64_t probes;
+	uint64_t hits;
+
+	static void compute(Position& pos, PawnEntry& entry);
+
+public:
+	PawnTable(unsigned int size_log2 = 14); // 2^14 entries is about 700KB
+
+	PawnEntry& probe(Position& pos);
+	void clear();
+	uint64_t get_probes() { return probes; }
+	uint64_t get_hits() { return hits; }
+};
+
+// Pawn structure plus pawn shield, from white's point of view, blended by the position's phase.
+int evaluate_pawns(Position& pos, PawnTable& table);
+
+// The same two steps without a Position or a table, for code that holds bare bitboards: the entry for a pawn configuration,
+// then the score for the king squares (indexed by color) and the phase, already capped at MAX_PHASE
+void compute_pawns(uint64_t white_pawns, uint64_t black_pawns, PawnEntry& entry);
+int pawn_score(const PawnEntry& entry, const std::array<unsigned int, 2>& kings, int phase);
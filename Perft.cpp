@@ -0,0 +1,220 @@
+#include "Perft.h"
+#include "Position.h"
+#include "Parallel.h"
+#include "Notation.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+#include <iomanip>
+
+std::vector<DivideEntry> perft_divide(Position& pos, unsigned int depth, unsigned int threads) {
+	std::vector<DivideEntry> entries;
+	for (auto& move : pos.move_gen()) {
+		entries.push_back({ move, 0, 0.0 });
+	}
+	if (depth == 0) {
+		return entries;
+	}
+
+	parallel_for(entries.size(), threads, [&](size_t index) {
+		DivideEntry& entry = entries[index];
+		Position child = pos; // every job plays on its own copy, without the accumulators, which can not be shared between threads
+		child.attach_accumulators(nullptr);
+		auto start = std::chrono::steady_clock::now();
+		entry.nodes = child.make_move(entry.move).perft(depth - 1);
+		entry.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	});
+	return entries;
+}
+
+void print_divide(std::vector<DivideEntry>& entries, double seconds, std::ostream& out) {
+	uint64_t nodes = 0;
+	out << std::fixed << std::setprecision(3);
+	for (auto& entry : entries) {
+		nodes += entry.nodes;
+		out << move_to_uci(entry.move) << ": " << entry.nodes << "  " << entry.seconds * 1000 << " ms, "
+			<< uint64_t(entry.seconds > 0 ? entry.nodes / entry.seconds : 0) << " nps" << std::endl;
+	}
+	out << std::endl << entries.size() << " moves, " << nodes << " nodes in " << seconds * 1000 << " ms, "
+		<< uint64_t(seconds > 0 ? nodes / seconds : 0) << " nps" << std::endl;
+	out << std::defaultfloat;
+}
+
+int perft_main(int argc, char* argv[]) {
+	const char* usage = "usage: perft [divide] <depth> [fen \"<fen>\"] [moves <move> ...] [threads <n>]";
+	int arg = 1;
+	bool divide = (arg < argc && std::string(argv[arg]) == "divide");
+	if (divide) { ++arg; }
+	unsigned int depth;
+	if (arg >= argc || !parse_number(argv[arg++], depth)) {
+		std::cerr << usage << std::endl;
+		return 2;
+	}
+
+	std::string fen = START_FEN;
+	std::vector<std::string> moves;
+	unsigned int threads = default_thread_count();
+	while (arg < argc) {
+		std::string option = argv[arg++];
+		if (option == "fen" && arg < argc) {
+			fen = argv[arg++];
+		}
+		else if (option == "threads" && arg < argc) {
+			if (!parse_number(argv[arg++], threads)) {
+				std::cerr << usage << std::endl;
+				return 2;
+			}
+			threads = std::max(1u, threads);
+		}
+		else if (option == "moves") {
+			while (arg < argc && std::string(argv[arg]) != "threads" && std::string(argv[arg]) != "fen") {
+				moves.push_back(argv[arg++]);
+			}
+		}
+	}
+
+	Position pos;
+	if (FenErrors error = pos.parse_fen(fen)) {
+		std::cerr << "invalid fen, " << fen_error_message(error) << std::endl;
+		return 2;
+	}
+	for (auto& text : moves) {
+		Move move;
+		if (!parse_uci_move(pos, text, move)) {
+			std::cerr << "illegal move " << text << std::endl;
+			return 2;
+		}
+		pos.make_move(move);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<DivideEntry> entries = perft_divide(pos, depth, threads);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (divide) {
+		print_divide(entries, seconds, std::cout);
+	}
+	else {
+		uint64_t nodes = (depth == 0) ? 1 : 0;
+		for (auto& entry : entries) { nodes += entry.nodes; }
+		std::cout << nodes << " nodes in " << seconds << " s, " << uint64_t(seconds > 0 ? nodes / seconds : 0) << " nps" << std::endl;
+	}
+	return 0;
+}
+
+std::vector<PerftCheck> read_perft_suite(std::istream& in, unsigned int max_depth) {
+	std::vector<PerftCheck> checks;
+	std::string text;
+	unsigned int line = 0;
+
+	while (std::getline(in, text)) {
+		++line;
+		size_t semicolon = text.find(';');
+		std::string fen = text.substr(0, semicolon);
+		fen.erase(0, std::min(fen.size(), fen.find_first_not_of(" \t")));
+		fen.erase(std::min(fen.size(), fen.find_last_not_of(" \t\r") + 1));
+		if (fen.empty() || fen[0] == '#') {
+			continue;
+		}
+
+		Position pos;
+		if (FenErrors error = pos.parse_fen(fen)) {
+			std::cerr << "line " << line << ": invalid fen, " << fen_error_message(error) << std::endl;
+			continue;
+		}
+
+		std::istringstream operations(semicolon == std::string::npos ? "" : text.substr(semicolon + 1));
+		std::string operation;
+		while (std::getline(operations, operation, ';')) {
+			std::istringstream tokens(operation);
+			std::string name, count;
+			if (!(tokens >> name) || name.size() < 2 || name[0] != 'D') {
+				continue;
+			}
+			unsigned int depth;
+			uint64_t expected;
+			if (!parse_number(name.substr(1), depth)) {
+				std::cerr << "line " << line << ": bad depth " << name << std::endl;
+				continue;
+			}
+			if (!(tokens >> count) || !parse_number(count, expected)) {
+				std::cerr << "line " << line << ": bad node count for " << name << std::endl;
+				continue;
+			}
+			if (depth <= max_depth) {
+				checks.push_back({ line, fen, depth, expected, 0, 0.0 });
+			}
+		}
+	}
+	return checks;
+}
+
+unsigned int run_perft_suite(std::vector<PerftCheck>& checks, unsigned int threads) {
+	// biggest first, so that one deep check started last does not leave every other thread idle at the end
+	std::vector<size_t> order(checks.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return checks[a].expected > checks[b].expected; });
+
+	parallel_for(order.size(), threads, [&](size_t index) {
+		PerftCheck& check = checks[order[index]];
+		Position pos(check.fen);
+		auto start = std::chrono::steady_clock::now();
+		check.nodes = pos.perft(check.depth);
+		check.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	});
+
+	unsigned int mismatches = 0;
+	for (auto& check : checks) {
+		mismatches += (check.nodes != check.expected);
+	}
+	return mismatches;
+}
+
+int perft_suite_main(int argc, char* argv[]) {
+	const char* usage = "usage: perft-suite <file.epd> [threads <n>] [depth <max>]";
+	if (argc < 2) {
+		std::cerr << usage << std::endl;
+		return 2;
+	}
+
+	unsigned int threads = default_thread_count();
+	unsigned int max_depth = 64;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		std::string option = argv[i];
+		bool valid = true;
+		if (option == "threads") { valid = parse_number(argv[i + 1], threads); }
+		else if (option == "depth") { valid = parse_number(argv[i + 1], max_depth); }
+		if (!valid) {
+			std::cerr << usage << std::endl;
+			return 2;
+		}
+	}
+	threads = std::max(1u, threads);
+
+	std::ifstream file(argv[1]);
+	if (!file) {
+		std::cerr << "could not open " << argv[1] << std::endl;
+		return 2;
+	}
+	std::vector<PerftCheck> checks = read_perft_suite(file, max_depth);
+
+	auto start = std::chrono::steady_clock::now();
+	unsigned int mismatches = run_perft_suite(checks, threads);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t nodes = 0;
+	for (auto& check : checks) {
+		nodes += check.nodes;
+		if (check.nodes != check.expected) {
+			std::cout << "mismatch on line " << check.line << " depth " << check.depth << ": expected " << check.expected
+				<< ", got " << check.nodes << "  " << check.fen << std::endl;
+		}
+	}
+	std::cout << checks.size() << " checks, " << checks.size() - mismatches << " passed, " << mismatches << " failed" << std::endl;
+	std::cout << nodes << " nodes in " << seconds << " s on " << threads << " threads, "
+		<< uint64_t(seconds > 0 ? nodes / seconds : 0) << " nodes per second" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include "stdint.h"
+#include "Move.h"
+
+class Position;
+
+// Perft below a single root move
+struct DivideEntry {
+	Move move;
+	uint64_t nodes;
+	double seconds;
+};
+
+// Runs perft below every root move as a separate job, across the given number of threads. Entries are in move generation order.
+std::vector<DivideEntry> perft_divide(Position& pos, unsigned int depth, unsigned int threads);
+void print_divide(std::vector<DivideEntry>& entries, double seconds, std::ostream& out);
+
+// perft [divide] <depth> [fen "<fen>"] [moves <move> ...] [threads <n>]
+int perft_main(int argc, char* argv[]);
+
+// One expected node count from an EPD perft suite, which lists them as "<fen> ;D1 20 ;D2 400 ;D3 8902"
+struct PerftCheck {
+	unsigned int line; // in the EPD file, for reporting
+	std::string fen;
+	unsigned int depth;
+	uint64_t expected;
+	uint64_t nodes; // filled in by run_perft_suite
+	double seconds;
+};
+
+std::vector<PerftCheck> read_perft_suite(std::istream& in, unsigned int max_depth);
+
+// Runs every check across the given number of threads, each with its own Position. Returns the number of mismatches.
+unsigned int run_perft_suite(std::vector<PerftCheck>& checks, unsigned int threads);
+
+// perft-suite <file.epd> [threads <n>] [depth <max>]
+int perft_suite_main(int argc, char* argv[]);
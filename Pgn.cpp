@@ -0,0 +1,237 @@
+#include "Pgn.h"
+#include "Notation.h"
+#include "Parallel.h"
+#include "MappedFile.h"
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+bool is_pgn_space(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+bool is_result(std::string_view token) {
+	return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+PgnStats read_pgn(std::string_view text, const PgnVisitor& visitor, uint64_t offset) {
+	PgnStats stats = { 0, 0, 0 };
+	Position pos;
+	std::string_view fen; // FEN tag of the game being read, empty for the start position
+	bool started = false; // something of the current game has been read
+	bool in_moves = false; // its movetext has started
+	bool failed = false; // it could not be replayed, skip to its end
+	size_t i = 0, n = text.size(), game_start = 0;
+
+	auto begin_game = [&](size_t at) {
+		if (!started) {
+			started = true;
+			game_start = at;
+		}
+	};
+	auto fail = [&](const std::string& message) {
+		if (!failed) {
+			++stats.errors;
+			if (visitor.error) { visitor.error(offset + game_start, message); }
+		}
+		failed = true;
+	};
+	auto begin_moves = [&]() {
+		if (in_moves) {
+			return;
+		}
+		in_moves = true;
+		FenErrors error = pos.parse_fen(fen.empty() ? std::string_view(START_FEN) : fen);
+		if (error != FEN_OK) {
+			fail(std::string("invalid FEN tag, ") + fen_error_message(error));
+		}
+		else if (visitor.game) {
+			visitor.game(pos);
+		}
+	};
+	auto end_game = [&](std::string_view result) {
+		if (!started) {
+			return;
+		}
+		begin_moves();
+		if (!failed) {
+			++stats.games;
+			if (visitor.end) { visitor.end(pos, result); }
+		}
+		fen = std::string_view();
+		started = in_moves = failed = false;
+	};
+
+	while (i < n) {
+		char c = text[i];
+		if (is_pgn_space(c)) {
+			++i;
+		}
+		else if (c == '[') { // tag pair: [Name "value"]
+			if (in_moves) { end_game("*"); } // the last game had no result
+			begin_game(i);
+			size_t name_start = ++i;
+			while (i < n && !is_pgn_space(text[i]) && text[i] != ']') { ++i; }
+			std::string_view name = text.substr(name_start, i - name_start), value;
+			while (i < n && text[i] != '"' && text[i] != ']' && text[i] != '\n') { ++i; }
+			if (i < n && text[i] == '"') {
+				size_t value_start = ++i;
+				while (i < n && text[i] != '"' && text[i] != '\n') { i += (text[i] == '\\') ? 2 : 1; }
+				value = text.substr(value_start, std::min(i, n) - value_start);
+			}
+			while (i < n && text[i] != ']' && text[i] != '\n') { ++i; }
+			++i;
+			if (name == "FEN") { fen = value; }
+			if (visitor.tag) { visitor.tag(name, value); }
+		}
+		else if (c == '{') { // comment, up to the closing brace
+			i = text.find('}', i);
+			i = (i == std::string_view::npos) ? n : i + 1;
+		}
+		else if (c == ';' || (c == '%' && (i == 0 || text[i - 1] == '\n'))) { // rest of line comment, escaped line
+			i = text.find('\n', i);
+			i = (i == std::string_view::npos) ? n : i + 1;
+		}
+		else if (c == '(') { // variation, possibly nested, which may hold comments with parentheses in them
+			int depth = 0;
+			for (; i < n; ++i) {
+				if (text[i] == '(') { ++depth; }
+				else if (text[i] == ')' && --depth == 0) { ++i; break; }
+				else if (text[i] == '{') {
+					i = text.find('}', i);
+					if (i == std::string_view::npos) { i = n; break; }
+				}
+			}
+		}
+		else if (c == '$' || c == ')') { // NAG, or a stray closing parenthesis
+			while (i < n && !is_pgn_space(text[i])) { ++i; }
+		}
+		else {
+			size_t token_start = i;
+			while (i < n && !is_pgn_space(text[i]) && text[i] != '{' && text[i] != '(' && text[i] != ')' && text[i] != ';' && text[i] != '[') { ++i; }
+			std::string_view token = text.substr(token_start, i - token_start);
+			begin_game(token_start);
+			if (is_result(token)) {
+				end_game(token);
+				continue;
+			}
+			begin_moves();
+			if (failed) {
+				continue;
+			}
+
+			// move numbers, "12." "12..." or run into the move as in "12.e4", but not castling written with zeros
+			size_t digits = 0;
+			while (digits < token.size() && token[digits] >= '0' && token[digits] <= '9') { ++digits; }
+			if (digits > 0 && (digits == token.size() || token[digits] == '.')) {
+				while (digits < token.size() && token[digits] == '.') { ++digits; }
+				token.remove_prefix(digits);
+				if (token.empty()) {
+					continue;
+				}
+			}
+
+			if (token.find_first_not_of("!?") == std::string_view::npos) { // annotation glyphs split off the move
+				continue;
+			}
+
+			Move move;
+			if (!parse_san(pos, token, move)) {
+				fail("illegal or ambiguous move " + std::string(token) + " at move " + std::to_string((pos.get_ply() + 1) / 2));
+				continue;
+			}
+			if (visitor.move) { visitor.move(pos, move); }
+			pos.make_move(move);
+			++stats.moves;
+		}
+	}
+	end_game("*");
+	return stats;
+}
+
+size_t next_game_start(std::string_view text, size_t offset) {
+	if (offset == 0) {
+		return 0;
+	}
+	// start from the first whole line at or after offset
+	size_t line = (text[offset - 1] == '\n') ? offset : text.find('\n', offset);
+	while (line != std::string_view::npos && line < text.size()) {
+		if (text[line] == '\n') { ++line; }
+		if (line < text.size() && text[line] == '[') {
+			// look back past blank lines to the line before, and check that it is not a tag of the same game
+			size_t back = line;
+			while (back > 0 && is_pgn_space(text[back - 1])) { --back; }
+			size_t previous = text.rfind('\n', back == 0 ? 0 : back - 1);
+			previous = (previous == std::string_view::npos) ? 0 : previous + 1;
+			while (previous < back && is_pgn_space(text[previous])) { ++previous; }
+			if (back == 0 || text[previous] != '[') {
+				return line;
+			}
+		}
+		line = text.find('\n', line);
+	}
+	return text.size();
+}
+
+PgnStats read_pgn_parallel(std::string_view text, unsigned int threads, const PgnVisitor& visitor) {
+	// a few ranges per thread, so that a thread that gets the long games does not hold up the others for long
+	size_t pieces = std::max<size_t>(1, std::min<size_t>(size_t(threads) * 8, text.size() / 4096));
+	std::vector<size_t> cuts = { 0 };
+	for (size_t piece = 1; piece < pieces; ++piece) {
+		size_t cut = next_game_start(text, text.size() / pieces * piece);
+		if (cut > cuts.back()) { cuts.push_back(cut); }
+	}
+	if (cuts.back() < text.size()) { cuts.push_back(text.size()); }
+
+	std::vector<PgnStats> results(cuts.size() - 1);
+	parallel_for(results.size(), threads, [&](size_t range) {
+		results[range] = read_pgn(text.substr(cuts[range], cuts[range + 1] - cuts[range]), visitor, cuts[range]);
+	});
+
+	PgnStats total = { 0, 0, 0 };
+	for (auto& result : results) {
+		total.games += result.games;
+		total.moves += result.moves;
+		total.errors += result.errors;
+	}
+	return total;
+}
+
+int pgn_main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "usage: pgn <file.pgn> [threads <n>]" << std::endl;
+		return 2;
+	}
+	unsigned int threads = default_thread_count();
+	for (int i = 2; i + 1 < argc; i += 2) {
+		if (std::string(argv[i]) == "threads") {
+			if (!parse_number(argv[i + 1], threads)) {
+				std::cerr << "usage: pgn <file.pgn> [threads <n>]" << std::endl;
+				return 2;
+			}
+			threads = std::max(1u, threads);
+		}
+	}
+
+	MappedFile file;
+	if (!file.open(argv[1])) {
+		std::cerr << "could not map " << argv[1] << std::endl;
+		return 2;
+	}
+
+	std::mutex error_mutex;
+	PgnVisitor visitor;
+	visitor.error = [&](uint64_t offset, std::string_view message) {
+		std::lock_guard<std::mutex> lock(error_mutex);
+		std::cerr << "game at byte " << offset << ": " << message << std::endl;
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	PgnStats stats = read_pgn_parallel(file.text(), threads, visitor);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << stats.games << " games, " << stats.moves << " moves, " << stats.errors << " failed, in " << seconds << " s on "
+		<< threads << " threads, " << uint64_t(seconds > 0 ? stats.moves / seconds : 0) << " moves per second" << std::endl;
+	return stats.errors == 0 ? 0 : 1;
+}
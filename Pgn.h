@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string_view>
+#include <functional>
+#include "stdint.h"
+#include "Position.h"
+#include "Move.h"
+
+// Callbacks for read_pgn, any of which may be left empty
+struct PgnVisitor {
+	std::function<void(std::string_view name, std::string_view value)> tag; // each tag pair, as written (escapes are not undone)
+	std::function<void(Position& pos)> game; // once the tags are read, with the position set up from the FEN tag or the start position
+	std::function<void(Position& pos, Move move)> move; // before each move is made
+	std::function<void(Position& pos, std::string_view result)> end; // after the last move. "1-0", "0-1", "1/2-1/2" or "*"
+	std::function<void(uint64_t offset, std::string_view message)> error; // a game that cannot be replayed, the rest of it is skipped
+};
+
+struct PgnStats {
+	uint64_t games; // replayed to the end
+	uint64_t moves;
+	uint64_t errors; // games given up on
+};
+
+// Reads every game in text in a single pass, replaying its moves with make_move on one Position. Comments, variations,
+// NAGs and escaped lines are skipped. offset is added to the byte offsets passed to the error callback.
+PgnStats read_pgn(std::string_view text, const PgnVisitor& visitor, uint64_t offset = 0);
+
+// The offset of the first game that starts at or after offset: a line beginning with '[' that does not follow another tag line
+size_t next_game_start(std::string_view text, size_t offset);
+
+// Cuts text into byte ranges, moves each cut forward to the next game start, and reads the ranges on the given number of
+// threads, each with its own Position. The visitor's callbacks are called from all of those threads at once.
+PgnStats read_pgn_parallel(std::string_view text, unsigned int threads, const PgnVisitor& visitor);
+
+// pgn <file.pgn> [threads <n>]
+// Memory maps the file, replays every game, and reports the counts and the rate. Games that fail are reported by offset.
+int pgn_main(int argc, char* argv[]);
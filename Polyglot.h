@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include "stdint.h"
+#include "Position.h"
+#include "Move.h"
+#include "MappedFile.h"
+
+// The position's key in the Polyglot opening book format, which has its own Zobrist keys and counts the en passant
+// square only when the side to move has a pawn that could capture on it
+uint64_t polyglot_key(Position& pos);
+
+struct BookMove {
+	Move move;
+	uint16_t weight;
+};
+
+// A Polyglot .bin opening book, memory mapped and probed in place. The file is a sorted array of 16 byte entries, so a
+// lookup is one binary search on the key. Entries whose move is not legal in the position are ignored.
+class PolyglotBook {
+private:
+	static const size_t ENTRY_SIZE = 16;
+
+	MappedFile file;
+	size_t count;
+	std::mt19937_64 random;
+
+	uint64_t key_at(size_t index) const;
+
+public:
+	PolyglotBook();
+
+	bool open(const std::string& path); // false if the file cannot be mapped or is not a whole number of entries
+	void close();
+	bool is_open() const { return count > 0; }
+	size_t size() const { return count; }
+
+	std::vector<BookMove> probe(Position& pos); // the book's moves for the position, in file order
+	bool pick_move(Position& pos, Move& move); // a book move chosen at random in proportion to the weights, false if there is none
+	bool pick_move(Position& pos, Move& move, std::mt19937_64& generator); // the same with the caller's generator, so that threads can share the book
+};
@@ -1,26 +1,28 @@
 #include "Position.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Attacks.h"
 
-std::vector<Position> pos_history = {}; // vector of past positions in the order they were played.
-std::vector<Move> move_history = {}; // vector of the past moves in the order they were played.
 
 void disp_move_history(std::vector<Move> move_history) {
 	for (auto& move: move_history) {
-		std::cout << move;
+		std::cout << move << ' ';
 	}
+	std::cout << std::endl;
 }
 
-std::vector<std::vector<int>> move_directions = { // map from piece types to valid move directions for each piece
-	{-8, 8}, // Pawn
-	{-17, -15, -10, -6, 6, 10, 15, 17}, // Knight
-	{-9, -7, 7, 9}, // Bishop
-	{-8, -1, 1, 8}, // Rook
-	{-9, -8, -7, -1, 1, 7, 8, 9}, // Queen
-	{-9, -8, -7, -1, 1, 7, 8, 9} // King
+const std::array<DirectionList, 6> move_directions = { // map from piece types to valid move directions for each piece
+	DirectionList{-8, 8}, // Pawn
+	DirectionList{-17, -15, -10, -6, 6, 10, 15, 17}, // Knight
+	DirectionList{-9, -7, 7, 9}, // Bishop
+	DirectionList{-8, -1, 1, 8}, // Rook
+	DirectionList{-9, -8, -7, -1, 1, 7, 8, 9}, // Queen
+	DirectionList{-9, -8, -7, -1, 1, 7, 8, 9} // King
 };
 
-std::vector<std::vector<int>> pawn_capt_directions = {
-	{-9, -7}, // White
-	{7, 9} // Black
+const std::array<DirectionList, 2> pawn_capt_directions = {
+	DirectionList{-9, -7}, // White
+	DirectionList{7, 9} // Black
 };
 
 //std::map<int, Bitboard> move_masks = { // map of move directions to bitmasks for the move generation
@@ -46,138 +48,272 @@ MoveOptions operator|(MoveOptions lhs, MoveOptions rhs) {
 	return static_cast<MoveOptions> (int (lhs) | int (rhs));
 }
 
-void Position::parse_fen(std::string fen) {
-	//TODO: implement a way to backup the values so if a parse error occurs, we can revert the position.
+const char* fen_error_message(FenErrors error) {
+	switch (error) {
+	case FEN_OK: return "ok";
+	case FEN_BAD_BOARD: return "piece placement is not eight ranks of eight squares";
+	case FEN_BAD_KINGS: return "each side needs exactly one king";
+	case FEN_BAD_TURN: return "side to move is not w or b";
+	case FEN_BAD_CASTLING: return "castling rights are not - or a combination of KQkq";
+	case FEN_BAD_EP: return "en passant square is not - or a square on the third or sixth rank";
+	case FEN_BAD_CLOCKS: return "move clocks are not numbers";
+	}
+	return "unknown error";
+}
 
-	unsigned int sq_counter = 0, char_index = 0, file, rank;
-	bool turn;
-	char c, file_c, rank_c;
-	std::string s;
-	Square cur_sq = Square(1); // initialize to the first square
-	Colors color;
-	Types type;
+Position::Position(std::string_view fen) : accumulators(nullptr) {
+	if (parse_fen(fen) != FEN_OK) {
+		parse_fen(START_FEN);
+	}
+}
 
-	// clean slate bitboards
-	for (auto& bb : pieces_by_color) { bb = Bitboard(); };
-	for (auto& bb : pieces_by_type) { bb = Bitboard(); };
-	epsq = Square();
+// Parses into locals first and only writes the position once the whole FEN has been accepted, so a bad FEN never leaves
+// a half-built position behind. The board is read in FEN order, which is also the bit order (a8 is bit 0, h1 is bit 63).
+// The move clocks may be left off, as they often are in EPD files, and then default to "0 1".
+FenErrors Position::parse_fen(std::string_view fen) {
+	TRACE_SPAN("parse_fen");
+	std::array<uint64_t, 2> colors = {};
+	std::array<uint64_t, 6> types = {};
+	unsigned int sq = 0, file = 0, ply_count = 0, move_number = 1;
+	uint8_t castling = 0;
+	int ep_index = -1;
+	bool white;
+	size_t i = 0, end = fen.size();
+
+	auto skip_spaces = [&]() { while (i < end && fen[i] == ' ') { ++i; } };
+	auto at_field_end = [&]() { return i == end || fen[i] == ' '; };
+	auto read_number = [&](unsigned int& value) {
+		if (at_field_end()) { return false; }
+		value = 0;
+		for (; !at_field_end(); ++i) {
+			if (fen[i] < '0' || fen[i] > '9' || value > 100000) { return false; }
+			value = value * 10 + (fen[i] - '0');
+		}
+		return true;
+	};
+
+	skip_spaces();
+	for (; !at_field_end(); ++i) {
+		char c = fen[i];
+		if (c == '/') {
+			if (file != 8 || sq >= 64) { return FEN_BAD_BOARD; }
+			file = 0;
+			continue;
+		}
+		if (c >= '1' && c <= '8') {
+			file += c - '0';
+			sq += c - '0';
+			if (file > 8) { return FEN_BAD_BOARD; }
+			continue;
+		}
 
-	// clean slate flags
-	flags = 0;  // Unset the flags to clear the slate
+		int type;
+		switch (c | 0x20) { // lowercase
+		case 'p': type = PAWN; break;
+		case 'n': type = KNIGHT; break;
+		case 'b': type = BISHOP; break;
+		case 'r': type = ROOK; break;
+		case 'q': type = QUEEN; break;
+		case 'k': type = KING; break;
+		default: return FEN_BAD_BOARD;
+		}
+		if (file >= 8) { return FEN_BAD_BOARD; }
+		colors[c >= 'a' ? BLACK : WHITE] |= 1ULL << sq;
+		types[type] |= 1ULL << sq;
+		++sq;
+		++file;
+	}
+	if (sq != 64 || file != 8) { return FEN_BAD_BOARD; }
+	for (auto color : colors) {
+		uint64_t kings = color & types[KING];
+		if (kings == 0 || (kings & (kings - 1)) != 0) { return FEN_BAD_KINGS; }
+	}
 
-	while (sq_counter < 64) {								// iterate over characters that "setup" the board
-		c = fen[char_index++];								// consume a character
+	skip_spaces();
+	if (i == end || (fen[i] != 'w' && fen[i] != 'b')) { return FEN_BAD_TURN; }
+	white = fen[i++] == 'w';
+	if (!at_field_end()) { return FEN_BAD_TURN; }
 
-		if (isdigit(c)) {									// if char is a digit, then there are empty squares
-			unsigned int empty_sqs = c - '0';				// subtract ascii value of '0' from c. Ex. if c is '7' then this will be 55 - 48 = 7.
-			if (empty_sqs < 1 || empty_sqs > 8) {			// only 1-8 are valid
-				// TODO: exception case - not a recognized number of empty squares!
-				return;
+	skip_spaces();
+	if (at_field_end()) { return FEN_BAD_CASTLING; }
+	if (fen[i] == '-') {
+		++i;
+	}
+	else {
+		for (; !at_field_end(); ++i) {
+			switch (fen[i]) {
+			case 'K': castling |= (1 << 0); break; // White Kingside castle
+			case 'Q': castling |= (1 << 1); break; // White Queenside castle
+			case 'k': castling |= (1 << 2); break; // Black Kingside castle
+			case 'q': castling |= (1 << 3); break; // Black Queenside castle
+			default: return FEN_BAD_CASTLING;
 			}
-			sq_counter += empty_sqs;						// skip the empty squares and do nothing with them
-			cur_sq.next(empty_sqs);
 		}
-		else if (isalpha(c)) {								//if char is alphabetical, then it must be a piece.
-
-			if (isupper(c)) { color = Colors::WHITE; }		// uppercase letters are for white
-			else			{ color = Colors::BLACK; }		// lowercase for black
-			c = tolower(c);									// convert to lowercase to simplify processing
-															// each character corresponds to a piece type
-			if		(c == 'p') { type = Types::PAWN; }
-			else if (c == 'n') { type = Types::KNIGHT; }
-			else if (c == 'b') { type = Types::BISHOP; }
-			else if (c == 'r') { type = Types::ROOK; }
-			else if (c == 'q') { type = Types::QUEEN; }
-			else if (c == 'k') { type = Types::KING; }
-			else {
-				// TODO: exception case - not a recognized piece!
-				return;
-			}
+	}
+	if (!at_field_end()) { return FEN_BAD_CASTLING; }
+
+	skip_spaces();
+	if (at_field_end()) { return FEN_BAD_EP; }
+	if (fen[i] == '-') {
+		++i;
+	}
+	else {
+		if (i + 1 >= end || fen[i] < 'a' || fen[i] > 'h' || (fen[i + 1] != '3' && fen[i + 1] != '6')) { return FEN_BAD_EP; }
+		ep_index = ('8' - fen[i + 1]) * 8 + (fen[i] - 'a');
+		i += 2;
+	}
+	if (!at_field_end()) { return FEN_BAD_EP; }
+
+	skip_spaces();
+	if (i < end) {
+		if (!read_number(ply_count)) { return FEN_BAD_CLOCKS; }
+		skip_spaces();
+		if (i < end && !read_number(move_number)) { return FEN_BAD_CLOCKS; }
+		skip_spaces();
+		if (i < end) { return FEN_BAD_CLOCKS; }
+	}
+
+	load(colors, types, white, castling, ep_index, ply_count, move_number);
+	return FEN_OK;
+}
 
-			pieces_by_color[color].mark_square(cur_sq);		// mark the square were on with the color of the piece we parsed
-			pieces_by_type[type].mark_square(cur_sq);		// mark the square were on with the piece type we parsed
-			cur_sq.next();									// get the next square
+// Replaces the whole position with one that has already been validated, and starts a fresh history from it
+void Position::load(const std::array<uint64_t, 2>& colors, const std::array<uint64_t, 6>& types, bool white, uint8_t castling, int ep_index,
+	unsigned int ply_count, unsigned int move_number) {
+	for (int color = 0; color < 2; ++color) { pieces_by_color[color] = Bitboard(colors[color]); }
+	for (int type = 0; type < 6; ++type) { pieces_by_type[type] = Bitboard(types[type]); }
+	epsq = ep_index >= 0 ? Square(static_cast<unsigned int>(ep_index)) : Square();
+	flags = castling;
+	ply_clock = static_cast<uint16_t>(ply_count);
+	plies_from_null = 0;
+	ply = static_cast<uint16_t>(std::max(move_number, 1u) * 2 - (white ? 1 : 0)); // calculate the ply from the full turn count and whose move it is
+	state_history.clear();
+	threat_history.clear();
+	move_history.clear();
+	key_history.clear();
+
+	refresh_eval();
+	refresh_keys();
+	king_threats();
+	if (accumulators) { attach_accumulators(accumulators); }
+}
+
+size_t Position::to_fen(char* buffer, size_t size) {
+	char fen[MAX_FEN_LENGTH];
+	size_t n = 0;
+	uint64_t white = pieces_by_color[WHITE].get_u64(), occupied = white | pieces_by_color[BLACK].get_u64();
+	std::array<uint64_t, 6> types;
+	for (int type = 0; type < 6; ++type) { types[type] = pieces_by_type[type].get_u64(); }
+
+	auto write_number = [&](unsigned int value) {
+		char digits[10];
+		int count = 0;
+		do { digits[count++] = static_cast<char>('0' + value % 10); value /= 10; } while (value);
+		while (count) { fen[n++] = digits[--count]; }
+	};
 
-			++sq_counter;									// increment the square counter to the next square
+	for (unsigned int sq = 0; sq < 64; ++sq) {
+		uint64_t bit = 1ULL << sq;
+		if (occupied & bit) {
+			int type = 0;
+			while (!(types[type] & bit)) { ++type; }
+			fen[n++] = (white & bit) ? "PNBRQK"[type] : "pnbrqk"[type];
 		}
-		else if (c == '/') {
-			// Currently there is no reason to do anything here, since we just ignore this character. However, should check that it was not misplaced for validity.
+		else if (n > 0 && fen[n - 1] >= '1' && fen[n - 1] <= '7' && sq % 8 != 0) {
+			++fen[n - 1]; // extend the run of empty squares
 		}
-		else if (c == ' ') { // Finished parsing the board setup portion
-			break;
+		else {
+			fen[n++] = '1';
 		}
+		if (sq % 8 == 7 && sq != 63) { fen[n++] = '/'; }
 	}
 
-	while ((c = fen[char_index++]) == ' '); // Consume spaces
+	fen[n++] = ' ';
+	fen[n++] = get_turn() == WHITE ? 'w' : 'b';
+	fen[n++] = ' ';
+	if ((flags & 0b1111) == 0) { fen[n++] = '-'; }
+	for (int right = 0; right < 4; ++right) {
+		if (flags & (1 << right)) { fen[n++] = "KQkq"[right]; }
+	}
+	fen[n++] = ' ';
+	if (epsq.is_empty()) {
+		fen[n++] = '-';
+	}
+	else {
+		unsigned int index = epsq.convert_to_index();
+		fen[n++] = static_cast<char>('a' + index % 8);
+		fen[n++] = static_cast<char>('8' - index / 8);
+	}
+	fen[n++] = ' ';
+	write_number(ply_clock);
+	fen[n++] = ' ';
+	write_number((ply + 1) / 2);
 
-		if (c == 'w') { turn = true; }
-		else if (c == 'b') { turn = false; }
-		else {
-			// TODO: Exception case - not a recognized player!
-			return;
-		}
+	if (n + 1 > size) {
+		return 0;
+	}
+	std::copy(fen, fen + n, buffer);
+	buffer[n] = '\0';
+	return n;
+}
 
-	while ((c = fen[char_index++]) == ' '); // Consume spaces
+std::string Position::to_fen() {
+	char fen[MAX_FEN_LENGTH];
+	size_t length = to_fen(fen, sizeof(fen));
+	return std::string(fen, length);
+}
 
-	if (c == '-') {} // If the castling string is a dash, we can ignore it and move on
-	else {
-		do {
-			if (c == 'K') { flags |= (1 << 0); } // Set White Kingside castle
-			else if (c == 'Q') { flags |= (1 << 1); } // Set White Queenside castle
-			else if (c == 'k') { flags |= (1 << 2); } // Set Black Kingside castle
-			else if (c == 'q') { flags |= (1 << 3); } // Set Black Queenside castle
-			else {
-				// TODO: Exception case - not a recognized castling right!
-				return;
-			}
-		} while ((c = fen[char_index++]) != ' '); // Consume characters until there is a space
-	}
-
-	while ((c = fen[char_index++]) == ' '); // Consume spaces
-
-	if (c == '-') {} // again, ignore and move on
-	else { // otherwise...
-		// parse the square in algebraic notation
-		file_c = c;
-		rank_c = fen[char_index++];
-		// compute the numeric rank and file
-		file = file_c - 'a';
-		rank = rank_c - '1';
-		if (file >= 8 || rank >= 8) { // if either the rank or file is out of bounds...
-			// TODO: Exception case - parsed algebraic notation is not on board!
-			return;
-		}
-		else { // otherwise compute the bitboard of the en passant square
-			epsq = Square(rank, file); // Sets the en passant square to the computed rank and file
-		}
+bool Position::pack(PackedPosition& packed) {
+	uint64_t white = pieces_by_color[WHITE].get_u64(), occupied = white | pieces_by_color[BLACK].get_u64();
+	std::array<uint64_t, 6> types;
+	for (int type = 0; type < 6; ++type) { types[type] = pieces_by_type[type].get_u64(); }
+
+	packed = PackedPosition();
+	packed.occupancy = occupied;
+	unsigned int count = 0;
+	for (uint64_t rest = occupied; rest; rest &= rest - 1, ++count) {
+		if (count >= 32) { return false; }
+		uint64_t bit = rest & (0 - rest); // lowest occupied square
+		uint8_t code = 0;
+		while (!(types[code] & bit)) { ++code; }
+		if (!(white & bit)) { code |= 8; }
+		packed.pieces[count / 2] |= static_cast<uint8_t>(code << (count % 2 * 4));
 	}
 
-	while ((c = fen[char_index++]) == ' '); // Consume spaces
-
-	do {
-		if (!isdigit(c)) {
-			// TODO: Exception case - not a numeric value!
-			return;
-		}
-		s.append(1, c); // append the digit characters to the string
-	} while ((c = fen[char_index++]) != ' '); // get the next character and check it against the space constant
-	ply_clock = std::stoi(s); // convert the string to an integer and store
-	s.clear();
+	packed.state = static_cast<uint8_t>((get_turn() == BLACK ? 1 : 0) | (flags & 0b1111) << 1);
+	packed.ep_square = epsq.is_empty() ? PackedPosition::NO_EP_SQUARE : static_cast<uint8_t>(epsq.convert_to_index());
+	packed.ply_clock = ply_clock;
+	packed.move_number = static_cast<uint16_t>((ply + 1) / 2);
+	return true;
+}
 
-	while ((c = fen[char_index++]) == ' '); // Consume spaces
+// Validated as strictly as parse_fen, since the records may come from anywhere
+bool Position::unpack(const PackedPosition& packed) {
+	std::array<uint64_t, 2> colors = {};
+	std::array<uint64_t, 6> types = {};
+	unsigned int count = 0;
+	for (uint64_t rest = packed.occupancy; rest; rest &= rest - 1, ++count) {
+		if (count >= 32) { return false; }
+		uint64_t bit = rest & (0 - rest);
+		unsigned int code = (packed.pieces[count / 2] >> (count % 2 * 4)) & 0xF;
+		if ((code & 7) > KING) { return false; }
+		colors[code >> 3] |= bit;
+		types[code & 7] |= bit;
+	}
+	for (auto color : colors) {
+		uint64_t kings = color & types[KING];
+		if (kings == 0 || (kings & (kings - 1)) != 0) { return false; }
+	}
+	if (packed.state >> 7) { return false; } // bits 5-6 hold a game result, which is not part of the position
 
-	do {
-		if (!isdigit(c)) {
-			// TODO: Exception case - not a numeric value!
-			return;
-		}
-		s.append(1, c); // append the digit characters to the string
-	} while ((c = fen[char_index++]) != '\0'); // get the next character and check it against the end-of-string constant
-	ply = std::stoi(s) * 2 - (turn ? 1 : 0); // calculate the ply from the full turn count and whose move it is
-	
-	king_threats();
+	int ep_index = -1;
+	if (packed.ep_square != PackedPosition::NO_EP_SQUARE) {
+		if (packed.ep_square / 8 != 2 && packed.ep_square / 8 != 5) { return false; } // the sixth or third rank
+		ep_index = packed.ep_square;
+	}
 
-	return;
+	load(colors, types, !(packed.state & 1), static_cast<uint8_t>((packed.state >> 1) & 0xF), ep_index, packed.ply_clock, packed.move_number);
+	return true;
 }
 
 void Position::disp_bitboard(Bitboard bitboard, std::string title, char piece_c, char empty_c) {
@@ -217,7 +353,7 @@ void Position::disp_bitboard(Bitboard bitboard) {
 
 bool Position::is_castle_legal(CastleSide side) {
 	Square king_sq = pieces_by_color[get_turn()] & pieces_by_type[KING];
-	std::vector<Square> be_empty, be_safe;
+	FixedList<Square, 3> be_empty, be_safe;
 	Bitboard all_pieces = pieces_by_color[WHITE] | pieces_by_color[BLACK];
 
 	assert(side == QUEENSIDE || side == KINGSIDE);
@@ -390,7 +526,80 @@ void Position::disp(bool show_all) {
 	}
 }
 
+// Every piece that make_move adds or removes goes through put_piece / remove_piece, which keep the incremental evaluation in step with the bitboards.
+void Position::put_piece(Colors color, Types type, Square sq) {
+	auto index = sq.convert_to_index();
+	pieces_by_color[color].mark_square(sq);
+	pieces_by_type[type].mark_square(sq);
+	mg_score += mg_value(color, type, index);
+	eg_score += eg_value(color, type, index);
+	phase += phase_weights[type];
+	key ^= zobrist.pieces[color][type][index];
+	if (type == PAWN) { pawn_key ^= zobrist.pieces[color][type][index]; }
+	if (accumulators) { accumulators->update(*this, color, type, index, true); }
+}
+
+void Position::remove_piece(Colors color, Types type, Square sq) {
+	auto index = sq.convert_to_index();
+	pieces_by_color[color].clear_square(sq);
+	pieces_by_type[type].clear_square(sq);
+	mg_score -= mg_value(color, type, index);
+	eg_score -= eg_value(color, type, index);
+	phase -= phase_weights[type];
+	key ^= zobrist.pieces[color][type][index];
+	if (type == PAWN) { pawn_key ^= zobrist.pieces[color][type][index]; }
+	if (accumulators) { accumulators->update(*this, color, type, index, false); }
+}
+
+// Recomputes the incremental evaluation from scratch, only needed when the board is set up without make_move.
+void Position::refresh_eval() {
+	mg_score = 0;
+	eg_score = 0;
+	phase = 0;
+	for (int c = 0; c < 2; ++c) {
+		for (int t = 0; t < 6; ++t) {
+			auto color = static_cast<Colors>(c);
+			auto type = static_cast<Types>(t);
+			Bitboard pieces = pieces_by_color[color] & pieces_by_type[type];
+			while (!pieces.is_empty()) {
+				auto index = pieces.pop_occupied().convert_to_index();
+				mg_score += mg_value(color, type, index);
+				eg_score += eg_value(color, type, index);
+				phase += phase_weights[type];
+			}
+		}
+	}
+}
+
+// Recomputes both Zobrist keys from scratch, only needed when the board is set up without make_move.
+void Position::refresh_keys() {
+	key = 0;
+	pawn_key = 0;
+	for (int c = 0; c < 2; ++c) {
+		for (int t = 0; t < 6; ++t) {
+			Bitboard pieces = pieces_by_color[c] & pieces_by_type[t];
+			while (!pieces.is_empty()) {
+				auto index = pieces.pop_occupied().convert_to_index();
+				key ^= zobrist.pieces[c][t][index];
+				if (t == PAWN) { pawn_key ^= zobrist.pieces[c][t][index]; }
+			}
+		}
+	}
+	key ^= zobrist.castling[flags & 0b1111];
+	if (!epsq.is_empty()) { key ^= zobrist.ep_file[epsq.convert_to_index() % 8]; }
+	if (get_turn() == BLACK) { key ^= zobrist.black_to_move; }
+}
+
+// Brings the castling, e.p. and side to move parts of the key up to date after a move. Pieces are handled by put_piece / remove_piece.
+void Position::update_state_key(uint8_t old_flags, Square old_epsq) {
+	key ^= zobrist.castling[old_flags & 0b1111] ^ zobrist.castling[flags & 0b1111];
+	if (!old_epsq.is_empty()) { key ^= zobrist.ep_file[old_epsq.convert_to_index() % 8]; }
+	if (!epsq.is_empty()) { key ^= zobrist.ep_file[epsq.convert_to_index() % 8]; }
+	key ^= zobrist.black_to_move;
+}
+
 Position& Position::make_move(Move move) {
+	TRACE_SPAN("make_move");
 	auto move_type = move.get_move_type();
 	Colors turn = get_turn();
 	Types type = move.get_type();
@@ -399,9 +608,16 @@ Position& Position::make_move(Move move) {
 	Square from = move.get_from();
 	Square to = move.get_to();
 	Square special = move.get_special();
+	uint8_t old_flags = flags;
+	Square old_epsq = epsq;
 
-	pos_history.push_back(*this);
+	state_history.push_back(static_cast<PositionState&>(*this));
+	threat_history.push_back(static_cast<KingThreats&>(*this));
 	move_history.push_back(move);
+	key_history.push_back(key);
+	if (accumulators) { accumulators->push(); }
+	++plies_from_null;
+	STAT_INC(static_cast<StatCounters>(STAT_MAKE_MOVE_STD + move_type));
 
 	switch (move_type) {
 		case STD:
@@ -409,7 +625,7 @@ Position& Position::make_move(Move move) {
 			// and update the ply clock
 
 			// if this is a capture move
-			if (pieces_by_color[!turn].contains(from)) {
+			if (pieces_by_color[!turn].contains(to)) {
 				// if captured piece is rook
 				if (pieces_by_type[ROOK].contains(to)) {
 					// if whites turn
@@ -442,34 +658,34 @@ Position& Position::make_move(Move move) {
 				// reset ply clock
 				ply_clock = 0;
 			}
+			else {
+				// quiet non-pawn moves increment the ply clock, pawn moves reset it below
+				++ply_clock;
+			}
 
 			if (type == KING) {
 				// remove both Q and K castle rights
 				set_castle_right(turn, QUEENSIDE, false);
 				set_castle_right(turn, KINGSIDE, false);
-				
-				// increment ply clock
-				++ply_clock;
 			}
 			else if (type == ROOK) {
+				unsigned int home_rank = (turn == WHITE) ? 0 : 7;
 				// if its the Queenside rook...
-				if (from.on_nth_file(0)) {
+				if (from.on_nth_file(0) && from.on_nth_rank(home_rank)) {
 					// remove the Q castle rights
 					set_castle_right(turn, QUEENSIDE, false);
 				}
 				// else if its the Kingside rook...
-				else if (from.on_nth_file(7)) {
+				else if (from.on_nth_file(7) && from.on_nth_rank(home_rank)) {
 					// remove the K castle rights
 					set_castle_right(turn, KINGSIDE, false);
 				}
-				// increment ply clock
-				++ply_clock;
 			}
 			// if this is a pawn move...
 			else if (type == PAWN) {
 				// set ep square
 				if (turn == WHITE) {
-					if (from.on_nth_rank(3) && to.on_nth_rank(1)) {
+					if (from.on_nth_rank(1) && to.on_nth_rank(3)) {
 						epsq = to << 8;
 					}
 					else {
@@ -495,18 +711,15 @@ Position& Position::make_move(Move move) {
 			}
 
 			// remove the moved piece off of its from square
-			pieces_by_color[turn].clear_square(from);
-			pieces_by_type[type].clear_square(from);
+			remove_piece(turn, type, from);
 
 			// remove the captured piece from the to square
 			if (capt_type >= 0) {
-				pieces_by_color[!turn].clear_square(to);
-				pieces_by_type[capt_type].clear_square(to);
+				remove_piece(!turn, capt_type, to);
 			}
 
 			// add the moved piece to its to square
-			pieces_by_color[turn].mark_square(to);
-			pieces_by_type[type].mark_square(to);
+			put_piece(turn, type, to);
 			
 			// increment the ply
 			++ply;
@@ -522,30 +735,25 @@ Position& Position::make_move(Move move) {
 			epsq = Square();
 
 			// remove the moved piece off of its from square
-			pieces_by_color[turn].clear_square(from);
-			pieces_by_type[type].clear_square(from);
+			remove_piece(turn, type, from);
 
 			// add the moved piece to its to square
-			pieces_by_color[turn].mark_square(to);
-			pieces_by_type[type].mark_square(to);
+			put_piece(turn, type, to);
 
 			// remove the special piece off of its from square
-			pieces_by_color[turn].clear_square(special);
-			pieces_by_type[ROOK].clear_square(special);
+			remove_piece(turn, ROOK, special);
 
 			// if the to square is on the c file...
 			if (to.on_nth_file(2)) {
 				//	   add the special piece to special << 3
 				auto special_to = special << 3;
-				pieces_by_color[turn].mark_square(special_to);
-				pieces_by_type[ROOK].mark_square(special_to);
+				put_piece(turn, ROOK, special_to);
 			}
 			// else if the to square is on the g file...
 			else if (to.on_nth_file(6)) {
 				//     add the special piece to special >> 2
 				auto special_to = special >> 2;
-				pieces_by_color[turn].mark_square(special_to);
-				pieces_by_type[ROOK].mark_square(special_to);
+				put_piece(turn, ROOK, special_to);
 			}
 
 			// increment the ply clock
@@ -558,7 +766,7 @@ Position& Position::make_move(Move move) {
 		case PROMOTION:
 
 			// if this is a capture move
-			if (pieces_by_color[!turn].contains(from)) {
+			if (pieces_by_color[!turn].contains(to)) {
 				// if captured piece is rook
 				if (pieces_by_type[ROOK].contains(to)) {
 					// if whites turn
@@ -591,18 +799,15 @@ Position& Position::make_move(Move move) {
 			}
 
 			// remove the moved piece off of its from square
-			pieces_by_color[turn].clear_square(from);
-			pieces_by_type[type].clear_square(from);
+			remove_piece(turn, type, from);
 
 			// remove the captured piece from the to square
 			if (capt_type >= 0) {
-				pieces_by_color[!turn].clear_square(to);
-				pieces_by_type[capt_type].clear_square(to);
+				remove_piece(!turn, capt_type, to);
 			}
 
-			// add the moved piece to its to square
-			pieces_by_color[turn].mark_square(to);
-			pieces_by_type[promote_type].mark_square(to);
+			// add the promoted piece to its to square
+			put_piece(turn, promote_type, to);
 
 			// clear epsq
 			epsq = Square();
@@ -616,16 +821,13 @@ Position& Position::make_move(Move move) {
 			break;
 		case EN_PASSANT:
 			// remove the moved piece off of its from square
-			pieces_by_color[turn].clear_square(from);
-			pieces_by_type[type].clear_square(from);
+			remove_piece(turn, type, from);
 
 			// add the moved piece to its to square
-			pieces_by_color[turn].mark_square(to);
-			pieces_by_type[type].mark_square(to);
+			put_piece(turn, type, to);
 
 			// remove the special piece from its square
-			pieces_by_color[!turn].clear_square(special);
-			pieces_by_type[PAWN].clear_square(special);
+			remove_piece(!turn, PAWN, special);
 
 			// clear epsq
 			epsq = Square();
@@ -638,62 +840,339 @@ Position& Position::make_move(Move move) {
 			break;
 	}
 
+	update_state_key(old_flags, old_epsq);
+	if (accumulators) { accumulators->refresh_dirty(*this); }
 	king_threats();
 	return *this;
 }
 
 Position& Position::undo() {
-	*this = pos_history.back();
-	pos_history.pop_back();
+	static_cast<PositionState&>(*this) = state_history.back();
+	static_cast<KingThreats&>(*this) = threat_history.back();
+	state_history.pop_back();
+	threat_history.pop_back();
 	move_history.pop_back();
+	key_history.pop_back();
+	if (accumulators) { accumulators->pop(); }
+	return *this;
+}
+
+// Starts keeping the network accumulators in step with this position, from a full rebuild. Pass nullptr to stop.
+void Position::attach_accumulators(AccumulatorStack* stack) {
+	accumulators = stack;
+	if (accumulators) {
+		accumulators->refresh(*this, WHITE);
+		accumulators->refresh(*this, BLACK);
+	}
+}
+
+// Passes the turn without moving a piece. Only used by the search (null-move pruning), never legal in a real game,
+// so it must not be made while in check. Undone like any other move, from the state history.
+Position& Position::make_null_move() {
+	assert(!is_in_check());
+
+	state_history.push_back(static_cast<PositionState&>(*this));
+	threat_history.push_back(static_cast<KingThreats&>(*this));
+	move_history.push_back(Move());
+	key_history.push_back(key);
+	if (accumulators) { accumulators->push(); }
+	plies_from_null = 0; // positions on either side of a null move do not repeat each other in any real game
+
+	// the e.p. capture is only available on the very next ply, which is being skipped
+	Square old_epsq = epsq;
+	epsq = Square();
+
+	++ply_clock;
+	++ply;
+
+	update_state_key(flags, old_epsq);
+
+	king_threats();
 	return *this;
 }
 
+Position& Position::undo_null_move() {
+	return undo();
+}
+
+void Position::reserve_history(size_t plies) {
+	state_history.reserve(state_history.size() + plies);
+	threat_history.reserve(threat_history.size() + plies);
+	move_history.reserve(move_history.size() + plies);
+	key_history.reserve(key_history.size() + plies);
+}
+
+// A draw by the fifty move rule, or by repetition. Only positions since the last capture or pawn move can repeat, and only
+// every second one has the same side to move, so the scan of the key history is short. ply_from_root is how far the search
+// is from its root: a position first seen after the root is a draw on its first repetition, since the side that allowed it
+// could just as well allow it again, but one from the game before the root must be on the board for the third time.
+bool Position::is_draw(int ply_from_root) {
+	if (ply_clock >= 100) { // unless it is checkmate on the hundredth ply, which still counts
+		if (!is_in_check() || has_legal_move()) {
+			return true;
+		}
+	}
+	int end = std::min(ply_clock, plies_from_null), seen = 0;
+	for (int i = 4; i <= end; i += 2) {
+		if (key_history[key_history.size() - i] == key && (i < ply_from_root || ++seen == 2)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Whether the side to move has a move back to a position of the search since the last irreversible move, so that it can at
+// least draw by repetition: the key difference to each earlier position with the other side to move is looked up among the
+// reversible piece moves, and the move must have its path clear and a piece of the side to move on one of its squares. Lets
+// the search raise alpha to a draw a ply before the repetition is on the board. Positions from before the root are left to
+// is_draw, as one repetition of those is not yet a draw.
+bool Position::has_game_cycle(int ply_from_root) {
+	int end = std::min<int>({ ply_clock, plies_from_null, ply_from_root - 1 });
+	uint64_t occupied = get_occupied().get_u64(), own = pieces_by_color[get_turn()].get_u64();
+	for (int i = 3; i <= end; i += 2) {
+		const CuckooMove* move = cuckoo.find(key ^ key_history[key_history.size() - i]);
+		if (!move || (move->between & occupied)) {
+			continue;
+		}
+		uint64_t ends = ((uint64_t(1) << move->squares[0]) | (uint64_t(1) << move->squares[1])) & occupied;
+		if (ends != 0 && (ends & (ends - 1)) == 0 && (ends & own) != 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Adds one leaf of the perft tree, reached by move, to the counts
+void count_perft_leaf(Move move, bool check, perft_moves& counts) {
+	counts.moves++;
+	if (check) {
+		counts.checks++;
+	}
+	switch (move.get_move_type()) {
+		case STD:
+			if (move.get_capt_type() != NONE) {
+				counts.capts++;
+			}
+			break;
+		case EN_PASSANT:
+			counts.capts++;
+			counts.eps++;
+			break;
+		case PROMOTION:
+			counts.promos++;
+			break;
+		case CASTLE:
+			counts.castles++;
+			break;
+	}
+}
+
 void Position::perft(unsigned int depth, perft_moves& counts) {
 	if (depth == 0) {
-		counts.moves++;
-		//std::cout << "Move # " << counts.moves << std::endl;
-		//disp_move_history(move_history);
-		//std::cout << std::endl;
-		//disp();
-		if (is_in_check()) {
-			counts.checks++;
-			//std::cout << "CHECK #" << counts.checks << ":" << std::endl;
-			//disp_move_history(move_history);
-			//std::cout << std::endl;
-			//disp();
+		count_perft_leaf(move_history.back(), is_in_check(), counts);
+		return;
+	}
+	MoveList moves;
+	move_gen(moves);
+	if (depth == 1) { // the last ply is classified without being played, gives_check tells the checks apart
+		CheckInfo info = check_info();
+		for (auto& move : moves) {
+			count_perft_leaf(move, gives_check(move, info), counts);
 		}
-		auto prev_move = move_history.back();
-		switch (prev_move.get_move_type()) {
-			case STD:
-				if (prev_move.get_capt_type() != NONE) {
-					counts.capts++;
-				}
-				break;
-			case EN_PASSANT:
-				counts.capts++;
-				counts.eps++;
-				//std::cout << "EP #" << counts.eps << ":" << std::endl;
-				//disp_move_history(move_history);
-				//std::cout << std::endl;
-				break;
-			case PROMOTION:
-				counts.promos++;
-				break;
-			case CASTLE:
-				counts.castles++;
-				break;
+		return;
+	}
+	for (auto& move : moves) {
+		this->make_move(move).perft(depth-1, counts);
+		this->undo();
+	}
+}
+
+uint64_t Position::perft(unsigned int depth) {
+	if (depth == 0) {
+		return 1;
+	}
+	if (depth == 1) {
+		return count_legal(); // the moves only need counting, not playing or even generating
+	}
+	MoveList moves;
+	move_gen(moves);
+	uint64_t nodes = 0;
+	for (auto& move : moves) {
+		nodes += this->make_move(move).perft(depth - 1);
+		this->undo();
+	}
+	return nodes;
+}
+
+// Counts the legal moves without making Move objects: each piece's targets as a bitboard, cut down to the check and pin rays
+// king_threats has already found, then popcounted. A pawn move onto the last rank counts as its four promotions. With
+// stop_at_first it returns as soon as anything has been found, which is all a mate or stalemate test needs.
+unsigned int Position::count_legal_moves(bool stop_at_first) {
+	Colors us = get_turn(), them = static_cast<Colors>(!us);
+	std::array<uint64_t, 6> ours, theirs;
+	for (int type = 0; type < 6; ++type) {
+		ours[type] = (pieces_by_type[type] & pieces_by_color[us]).get_u64();
+		theirs[type] = (pieces_by_type[type] & pieces_by_color[them]).get_u64();
+	}
+	uint64_t own = pieces_by_color[us].get_u64(), occupied = get_occupied().get_u64();
+	unsigned int king_sq = lowest_square(ours[KING]), count = 0;
+
+	// the king can go to any square the other side does not attack once the king has left its own
+	for (uint64_t targets = attack_tables.king[king_sq] & ~own; targets; targets &= targets - 1) {
+		if (!attackers_of(lowest_square(targets), them, theirs, occupied & ~ours[KING])) {
+			++count;
+			if (stop_at_first) { return count; }
 		}
 	}
-	else {
-		int sum = 0;
-		//this->disp();
-		for (auto& move : this->move_gen()) {
-			//std::cout << move;
-			this->make_move(move).perft(depth-1, counts);
-			this->undo();
+	if (checking_pieces.popcount() > 1) { // in double check only the king can move
+		return count;
+	}
+
+	bool in_check = is_in_check();
+	uint64_t target = ~own, pinned = pinned_pieces.get_u64();
+	if (in_check) { target &= check_vectors[0].get_u64(); } // block the check or capture the checker
+
+	// castling, with the squares the king crosses empty and safe
+	if (!in_check) {
+		for (int side = KINGSIDE; side <= QUEENSIDE; ++side) {
+			if (!(side == KINGSIDE ? K_castle_right() : Q_castle_right())) {
+				continue;
+			}
+			uint64_t king = ours[KING];
+			uint64_t crossed = (side == KINGSIDE) ? (king << 1) | (king << 2) : (king >> 1) | (king >> 2);
+			uint64_t empty = (side == KINGSIDE) ? crossed : crossed | (king >> 3);
+			bool safe = (occupied & empty) == 0;
+			for (uint64_t squares = crossed; safe && squares; squares &= squares - 1) {
+				safe = !attackers_of(lowest_square(squares), them, theirs, occupied);
+			}
+			if (safe) {
+				++count;
+				if (stop_at_first) { return count; }
+			}
+		}
+	}
+
+	// a pinned piece may only move along its pin, and not at all when the king is in check
+	auto restrict_pinned = [&](unsigned int sq, uint64_t moves) -> uint64_t {
+		uint64_t bit = uint64_t(1) << sq;
+		if (!(pinned & bit)) { return moves; }
+		if (in_check) { return 0; }
+		for (auto& spy_vector : spy_vectors) {
+			if (spy_vector.get_u64() & bit) { return moves & spy_vector.get_u64(); }
+		}
+		return 0;
+	};
+
+	for (int type = KNIGHT; type <= QUEEN; ++type) {
+		for (uint64_t pieces = ours[type]; pieces; pieces &= pieces - 1) {
+			unsigned int sq = lowest_square(pieces);
+			count += Bitboard(restrict_pinned(sq, piece_attacks(us, static_cast<Types>(type), sq, occupied) & target)).popcount();
+			if (stop_at_first && count) { return count; }
+		}
+	}
+
+	int forward = (us == WHITE) ? -8 : 8; // white pawns move towards square 0
+	uint64_t last_row = (us == WHITE) ? 0xFFULL : 0xFFULL << 56, start_row = (us == WHITE) ? 0xFFULL << 48 : 0xFFULL << 8;
+	for (uint64_t pawns = ours[PAWN]; pawns; pawns &= pawns - 1) {
+		unsigned int sq = lowest_square(pawns);
+		int one = int(sq) + forward;
+		uint64_t moves = attack_tables.pawn[us][sq] & pieces_by_color[them].get_u64();
+		if (one >= 0 && one < 64 && !(occupied & (uint64_t(1) << one))) {
+			moves |= uint64_t(1) << one;
+			if (((uint64_t(1) << sq) & start_row) && !(occupied & (uint64_t(1) << (one + forward)))) {
+				moves |= uint64_t(1) << (one + forward);
+			}
+		}
+		moves = restrict_pinned(sq, moves & target);
+		count += Bitboard(moves & ~last_row).popcount() + 4 * Bitboard(moves & last_row).popcount();
+		if (stop_at_first && count) { return count; }
+	}
+
+	// en passant takes a pawn off a square the capture does not land on, so rather than trusting the pin and check rays,
+	// look at the king on the board as it would be after the capture
+	if (!epsq.is_empty()) {
+		unsigned int ep = epsq.convert_to_index(), captured = ep - forward;
+		std::array<uint64_t, 6> remaining = theirs;
+		remaining[PAWN] &= ~(uint64_t(1) << captured);
+		for (uint64_t pawns = attack_tables.pawn[them][ep] & ours[PAWN]; pawns; pawns &= pawns - 1) {
+			uint64_t after = (occupied & ~(uint64_t(1) << lowest_square(pawns)) & ~(uint64_t(1) << captured)) | (uint64_t(1) << ep);
+			if (!attackers_of(king_sq, them, remaining, after)) {
+				++count;
+				if (stop_at_first) { return count; }
+			}
+		}
+	}
+	return count;
+}
+
+bool Position::has_legal_move() {
+	return count_legal_moves(true) > 0;
+}
+
+unsigned int Position::count_legal() {
+	return count_legal_moves(false);
+}
+
+CheckInfo Position::check_info() {
+	Colors us = get_turn(), them = static_cast<Colors>(!us);
+	CheckInfo info;
+	uint64_t occupied = get_occupied().get_u64(), own = pieces_by_color[us].get_u64();
+	info.king_sq = lowest_square((pieces_by_type[KING] & pieces_by_color[them]).get_u64());
+	info.check_squares[PAWN] = attack_tables.pawn[them][info.king_sq]; // a pawn of ours on one of these would attack the king
+	info.check_squares[KNIGHT] = attack_tables.knight[info.king_sq];
+	info.check_squares[BISHOP] = bishop_attacks(info.king_sq, occupied);
+	info.check_squares[ROOK] = rook_attacks(info.king_sq, occupied);
+	info.check_squares[QUEEN] = info.check_squares[BISHOP] | info.check_squares[ROOK];
+	info.check_squares[KING] = 0;
+
+	// a piece of ours that is all that stands between one of our sliders and their king
+	uint64_t diagonal = (pieces_by_type[BISHOP] | pieces_by_type[QUEEN]).get_u64() & own, straight = (pieces_by_type[ROOK] | pieces_by_type[QUEEN]).get_u64() & own;
+	info.candidates = 0;
+	for (uint64_t snipers = (bishop_attacks(info.king_sq, 0) & diagonal) | (rook_attacks(info.king_sq, 0) & straight); snipers; snipers &= snipers - 1) {
+		uint64_t between = squares_between(lowest_square(snipers), info.king_sq) & occupied;
+		if (between && !(between & (between - 1))) {
+			info.candidates |= between & own;
 		}
 	}
+	return info;
+}
+
+// Whether the move checks the other king, decided before it is made. A piece checks directly when it lands on one of the
+// check squares of its type, and uncovers a check when it leaves a discovery candidate, or with en passant or castling, where
+// more than one piece moves: then the sliders are looked at again with the board as it will be after the move. A promotion
+// checks as the piece it becomes, with its own square already empty.
+bool Position::gives_check(Move move, const CheckInfo& info) {
+	Colors us = get_turn();
+	unsigned int from = move.get_from().convert_to_index(), to = move.get_to().convert_to_index();
+	uint64_t from_bit = uint64_t(1) << from, to_bit = uint64_t(1) << to, king_bit = uint64_t(1) << info.king_sq;
+	uint64_t occupied = (get_occupied().get_u64() & ~from_bit) | to_bit, own = pieces_by_color[us].get_u64() & ~from_bit;
+	uint64_t diagonal = (pieces_by_type[BISHOP] | pieces_by_type[QUEEN]).get_u64() & own, straight = (pieces_by_type[ROOK] | pieces_by_type[QUEEN]).get_u64() & own;
+	bool uncovered = (info.candidates & from_bit) != 0;
+
+	switch (move.get_move_type()) {
+	case PROMOTION:
+		if (piece_attacks(us, move.get_promote_type(), to, occupied) & king_bit) { return true; }
+		break;
+	case EN_PASSANT:
+		if (info.check_squares[PAWN] & to_bit) { return true; }
+		occupied &= ~(uint64_t(1) << move.get_special().convert_to_index()); // the captured pawn may have been blocking a slider too
+		uncovered = true;
+		break;
+	case CASTLE: {
+		unsigned int rook_from = move.get_special().convert_to_index(), rook_to = (from + to) / 2;
+		occupied = (occupied & ~(uint64_t(1) << rook_from)) | (uint64_t(1) << rook_to);
+		straight = (straight & ~(uint64_t(1) << rook_from)) | (uint64_t(1) << rook_to); // the rook checks as a straight slider
+		uncovered = true;
+		break;
+	}
+	default:
+		if (info.check_squares[move.get_type()] & to_bit) { return true; }
+	}
+	return uncovered && ((bishop_attacks(info.king_sq, occupied) & diagonal) | (rook_attacks(info.king_sq, occupied) & straight)) != 0;
+}
+
+bool Position::gives_check(Move move) {
+	return gives_check(move, check_info());
 }
 
 Bitboard Position::get_occupied()
@@ -701,6 +1180,10 @@ Bitboard Position::get_occupied()
 	return pieces_by_color[Colors::WHITE] | pieces_by_color[Colors::BLACK];
 }
 
+Bitboard Position::get_pieces(Colors color, Types type) {
+	return pieces_by_color[color] & pieces_by_type[type];
+}
+
 Colors Position::get_turn() {
 	return static_cast<Colors>(((ply - 1) % 2));
 }
@@ -721,17 +1204,8 @@ bool Position::is_open(Square sq)
 	return ((~(pieces_by_color[0] | pieces_by_color[1])) & sq).is_empty();
 }
 
-void Position::set_in_check(bool set) {
-	if (set) {
-		flags |= (1 << 4); // set the "in-check" bit.
-	}
-	else {
-		flags &= (~(1 << 4)); // unset the "in-check" bit.
-	}
-}
-
 bool Position::is_in_check() {
-	return flags & (1 << 4);
+	return !checking_pieces.is_empty();
 }
 
 bool Position::is_opponent(Square sq) {
@@ -747,22 +1221,22 @@ bool Position::attacked_by_piece(Square sq, Types piece_type) {
 	Ray search_path = Ray(sq);
 	Square to;
 	int max_distance = Ray::NO_MAX;
-	std::vector<int> directions;
+	const DirectionList* directions;
 
 	if (piece_type == PAWN || piece_type == KNIGHT || piece_type == KING) { 
 		if (piece_type == PAWN) {
-			directions = pawn_capt_directions[get_turn()];
+			directions = &pawn_capt_directions[get_turn()];
 		}
 		else {
-			directions = move_directions[piece_type];
+			directions = &move_directions[piece_type];
 		}
 		max_distance = 1;
 	}
 	else {
-		directions = move_directions[piece_type];
+		directions = &move_directions[piece_type];
 	}
 
-	for (auto dir : directions) {
+	for (auto dir : *directions) {
 		search_path.reset(dir, max_distance);
 		while (!search_path.end()) {
 			to = (++search_path).get_current();
@@ -770,6 +1244,7 @@ bool Position::attacked_by_piece(Square sq, Types piece_type) {
 				if (is_type(to, piece_type)) {
 					return true;
 				}
+				break; // any other opponent's piece blocks the ray as well
 			}
 			else if (is_friend(to)) { // found a friendly piece, which blocks enemy pieces!
 				break;
@@ -790,6 +1265,8 @@ bool Position::square_covered(Square sq) {
 }
 
 void Position::king_threats() {
+	TRACE_SPAN("king_threats");
+	STAT_INC(STAT_KING_THREATS);
 	auto king_sq = (pieces_by_type[KING] & pieces_by_color[get_turn()]).pop_occupied();
 	assert(!king_sq.is_empty());
 
@@ -797,7 +1274,7 @@ void Position::king_threats() {
 	Square to, temp_pin;
 	Bitboard temp_attack_vector;
 	int max_distance;
-	std::vector<int> directions;
+	const DirectionList* directions;
 
 	// Reset all threat bitboards / vectors of bitboards
 	checking_pieces.clear();
@@ -811,21 +1288,21 @@ void Position::king_threats() {
 		switch (piece_type) {
 		case PAWN:
 			max_distance = 1;
-			directions = pawn_capt_directions[get_turn()];
+			directions = &pawn_capt_directions[get_turn()];
 			break;
 		case KNIGHT:
 			max_distance = 1;
-			directions = move_directions[piece_type];
+			directions = &move_directions[piece_type];
 			break;
 		case KING:
 			continue;
 		default:
 			max_distance = Ray::NO_MAX;
-			directions = move_directions[piece_type];
+			directions = &move_directions[piece_type];
 			break;
 		}
 
-		for (auto& dir : directions) {
+		for (auto& dir : *directions) {
 			// reinit data structures
 			search_path.reset(dir, max_distance);
 			temp_pin = Square();
@@ -862,13 +1339,11 @@ void Position::king_threats() {
 
 		}
 	}
-	set_in_check(checking_pieces.popcount() > 0);
 }
 
-std::vector<Move> Position::move_gen_generic(Square from, std::vector<int> directions, int max_distance, MoveOptions move_opts) {
+void Position::move_gen_generic(Square from, const DirectionList& directions, MoveList& moves, int max_distance, MoveOptions move_opts) {
 	Ray search_path = Ray(from);
 	Square to;
-	std::vector<Move> moves;
 	Types from_type = get_type(from);
 
 	assert(from_type != NONE); // make sure that the piece we are generating moves for isnt a none type
@@ -905,16 +1380,16 @@ std::vector<Move> Position::move_gen_generic(Square from, std::vector<int> direc
 			}
 		}
 	}
-	return moves;
 }
 
-std::vector<Move> Position::move_gen_sliders(Square from, Types type) {
+void Position::move_gen_sliders(Square from, Types type, MoveList& moves) {
 	assert(type != PAWN && type != KING); // function cannot be used with pawns or kings.
 	Bitboard attack_vector = Bitboard();
 	Square test_sq;
-	int test_dir, index;
-	std::vector<int> dirs, piece_dirs;
-	std::vector<Move> moves, temp_moves;
+	int test_dir;
+	size_t index, first = moves.size();
+	DirectionList dirs;
+	const DirectionList& piece_dirs = move_directions[type];
 
 	int max_distance = -1;
 	if (type == KNIGHT) { max_distance = 1; };
@@ -930,117 +1405,106 @@ std::vector<Move> Position::move_gen_sliders(Square from, Types type) {
 
 			assert(!attack_vector.is_empty()); // The attack vector cannot be empty if this piece is pinned.
 
-			piece_dirs = move_directions[type]; // Start with the full set of move directions for this piece.
+			Bitboard pin_vector = attack_vector;
 			while (!attack_vector.is_empty()) { // while the attack vector is not empty...
 				test_sq = attack_vector.pop_occupied(); // pop the next occupied square
 				test_dir = test_sq.direction_from(from); // compute the basic direction from the pinned piece to the square being tested.
 				auto matched_dir = std::find(piece_dirs.begin(), piece_dirs.end(), test_dir); // search the move directions of this piece for the computed direction
-				if (matched_dir != piece_dirs.end()) { // if the computed direction is one of the possible move directions...
+				if (matched_dir != piece_dirs.end() && std::find(dirs.begin(), dirs.end(), test_dir) == dirs.end()) { // if the computed direction is one of the possible move directions (and not already added)...
 					dirs.push_back(*matched_dir); // add this direction to a list of directions.
 				}
 			}
 
-			temp_moves = move_gen_generic(from, dirs, max_distance); // Compute the psuedolegal moves with the subset of directions found.
-			for (auto& temp_move : temp_moves) { // for each move...
-				test_sq = temp_move.get_to(); // get the square being moved to
-				if (spy_vectors[index].contains(test_sq)) { // and if the move is still in the same spy vector...
-					moves.push_back(temp_move); // the move is valid, so we add it to the list.
-				}
-			}
+			move_gen_generic(from, dirs, moves, max_distance); // Compute the psuedolegal moves with the subset of directions found.
+			// and keep only the moves that stay in the same spy vector
+			moves.erase(std::remove_if(moves.begin() + first, moves.end(), [&](Move& move) { Square to = move.get_to(); return !pin_vector.contains(to); }), moves.end());
 		}
 		else { // if the piece is not pinned...
-			moves = move_gen_generic(from, move_directions[type], max_distance); // all of its potential moves are legal, so compute them all.
+			move_gen_generic(from, piece_dirs, moves, max_distance); // all of its potential moves are legal, so compute them all.
 		}
 	}
 	else { // the king is in check...
 		assert(checking_pieces.popcount() == 1); // the king must only be in single check, outer function ensures this should be the case but this code is not valid for multiple check.
 
-		if (pinned_pieces.contains(from)) { // if this piece is pinned...
-			moves = {}; // there are no legal moves it can make.
-		}
-		else { // if the piece is not pinned...
+		if (!pinned_pieces.contains(from)) { // a pinned piece has no legal moves, otherwise...
 			attack_vector = check_vectors[0]; // get the attack vector of the checking piece
-			while (!attack_vector.is_empty()) { // while the attack vector is not empty...
-				test_sq = attack_vector.pop_occupied(); // get the next occupied square
+			Bitboard test_vector = attack_vector;
+			while (!test_vector.is_empty()) { // while the attack vector is not empty...
+				test_sq = test_vector.pop_occupied(); // get the next occupied square
 				test_dir = test_sq.direction_from(from); // compute the direction from this piece to the test square.
 				auto matched_dir = std::find(piece_dirs.begin(), piece_dirs.end(), test_dir); // search this pieces directions for the computed direction
-				if (matched_dir != piece_dirs.end()) { // if the direction was found...
+				if (matched_dir != piece_dirs.end() && std::find(dirs.begin(), dirs.end(), test_dir) == dirs.end()) { // if the direction was found (and not already added)...
 					dirs.push_back(*matched_dir); // add this direction to the possible directions to search.
 				}
 			}
-			temp_moves = move_gen_generic(from, dirs, max_distance); // get the subset of moves in the matching directions
-			for (auto temp_move : temp_moves) { // for each move...
-				auto temp_sq = temp_move.get_to(); // get the square the move is going to
-				if (attack_vector.contains(temp_sq)) { moves.push_back(temp_move); } // and if it is in the attack vector, add to the valid moves.
-			}
+			move_gen_generic(from, dirs, moves, max_distance); // get the subset of moves in the matching directions
+			// and keep only the moves into the attack vector
+			moves.erase(std::remove_if(moves.begin() + first, moves.end(), [&](Move& move) { Square to = move.get_to(); return !attack_vector.contains(to); }), moves.end());
 		}
 	}
-	return moves;
 }
 
-std::vector<Move> Position::move_gen_k(Square from)
+void Position::move_gen_k(Square from, MoveList& moves)
 {
 	assert(pieces_by_type[KING].contains(from)); //ensure that this piece is a king
-	std::vector<Move> moves, temp_moves;
+	size_t first = moves.size();
 
-	temp_moves = move_gen_generic(from, move_directions[KING], 1);	// Get king's psuedolegal moves
-	for (auto& temp_move : temp_moves) {							// for each psuedolegal move...
-		if (!square_covered(temp_move.get_to())) {					// if the move is to an unattacked square...
-			moves.push_back(temp_move);								// add it to the legal move list
-		}
-	}
+	move_gen_generic(from, move_directions[KING], moves, 1);		// Get king's psuedolegal moves
+	pieces_by_color[get_turn()].clear_square(from);					// lift the king off the board so that sliders see through its square,
+																	// otherwise stepping back along the line of a check looks safe.
+	moves.erase(std::remove_if(moves.begin() + first, moves.end(),	// keep only the moves to unattacked squares
+		[&](Move& move) { return square_covered(move.get_to()); }), moves.end());
+	pieces_by_color[get_turn()].mark_square(from);					// put the king back
 
 	if (!is_in_check()) { // if not in check...
 		if (K_castle_right() && is_castle_legal(KINGSIDE)) { // see if we have the right to castle kingside
-			temp_moves = move_gen_generic(from, { 2 }, 1); 
-			assert(temp_moves.size() == 1);
+			size_t before = moves.size();
+			move_gen_generic(from, { 2 }, moves, 1);
+			assert(moves.size() == before + 1);
 
 			// update move to be the more specific move type of castling
-			temp_moves[0].set_move_type(CASTLE).set_special(from << 3); // changes to a castle move and adds the King's rook square to the special field
-			moves.push_back(temp_moves[0]);
+			moves.back().set_move_type(CASTLE).set_special(from << 3); // changes to a castle move and adds the King's rook square to the special field
 		}
 		if (Q_castle_right() && is_castle_legal(QUEENSIDE)) { // see if we have the right to castle queenside
-			temp_moves = move_gen_generic(from, { -2 }, 1);
-			assert(temp_moves.size() == 1);
+			size_t before = moves.size();
+			move_gen_generic(from, { -2 }, moves, 1);
+			assert(moves.size() == before + 1);
 
-			temp_moves[0].set_move_type(CASTLE).set_special(from >> 4); // changes to a castle move and adds the Queen's rook square to the special field
-			moves.push_back(temp_moves[0]);
+			moves.back().set_move_type(CASTLE).set_special(from >> 4); // changes to a castle move and adds the Queen's rook square to the special field
 		}
 	}
-	return moves;
 }
 
-std::vector<Move> Position::move_gen_p(Square from) {
+void Position::move_gen_p(Square from, MoveList& moves) {
 	ASSERT_ONE_SQUARE(from);
-	std::vector<Move> pl_moves, moves, temp_moves;
 	Bitboard attack_vector;
 	Move promote_move;
 	unsigned int max_distance;
 	Colors turn = get_turn();
+	size_t first = moves.size();
 
 	// Start by calculating 
-	if (is_in_check() && pinned_pieces.contains(from)) { return {}; } // dont calculate any moves if the king is both in check and this piece is pinned (cuz it isnt possible to move)
+	if (is_in_check() && pinned_pieces.contains(from)) { return; } // dont calculate any moves if the king is both in check and this piece is pinned (cuz it isnt possible to move)
 
 	// Get pawn push moves
 	(from.on_pawn_start_rank(turn)) ? (max_distance = 2) : (max_distance = 1);
-	pl_moves = move_gen_generic(from, { move_directions[PAWN][turn] }, max_distance, MoveOptions::PLACE);
+	move_gen_generic(from, { move_directions[PAWN][turn] }, moves, max_distance, MoveOptions::PLACE);
 
 	// Get standard pawn capture moves
-	temp_moves = move_gen_generic(from, pawn_capt_directions[turn], 1, MoveOptions::CAPT);
-	pl_moves.insert(pl_moves.end(), temp_moves.begin(), temp_moves.end());
+	move_gen_generic(from, pawn_capt_directions[turn], moves, 1, MoveOptions::CAPT);
 
 	// Check all generated moves to see if any are eligible for promotion
-	int old_size = pl_moves.size();
-	for (int i = 0; i < old_size; ++i) {
-		if (pl_moves[i].get_to().on_promote_rank(turn)) {
-			promote_move = pl_moves[i].set_move_type(PROMOTION);
+	size_t old_size = moves.size();
+	for (size_t i = first; i < old_size; ++i) {
+		if (moves[i].get_to().on_promote_rank(turn)) {
+			promote_move = moves[i].set_move_type(PROMOTION);
 			for (int j = 1; j < 5; ++j) {
 				promote_move.set_promote_type(static_cast<Types>(j));
 				if (j == 1) {
-					pl_moves[i] = promote_move; // overwrite the found move with the first promotion move
+					moves[i] = promote_move; // overwrite the found move with the first promotion move
 				}
 				else {
-					pl_moves.push_back(promote_move); // append the remaining promotion moves
+					moves.push_back(promote_move); // append the remaining promotion moves
 				}
 			}
 		}
@@ -1050,18 +1514,18 @@ std::vector<Move> Position::move_gen_p(Square from) {
 	if (!epsq.is_empty()) {
 		if (turn == WHITE) {
 			if ((from >> 7) == epsq && !from.on_nth_file(7)) {
-				pl_moves.push_back(Move(from, epsq, from << 1, turn, PAWN, PAWN, NONE, EN_PASSANT));
+				moves.push_back(Move(from, epsq, from << 1, turn, PAWN, PAWN, NONE, EN_PASSANT));
 			}
 			if ((from >> 9) == epsq && !from.on_nth_file(0)) {
-				pl_moves.push_back(Move(from, epsq, from >> 1, turn, PAWN, PAWN, NONE, EN_PASSANT));
+				moves.push_back(Move(from, epsq, from >> 1, turn, PAWN, PAWN, NONE, EN_PASSANT));
 			}
 		}
 		else {
 			if ((from << 7) == epsq && !from.on_nth_file(0)) {
-				pl_moves.push_back(Move(from, epsq, from >> 1, turn, PAWN, PAWN, NONE, EN_PASSANT));
+				moves.push_back(Move(from, epsq, from >> 1, turn, PAWN, PAWN, NONE, EN_PASSANT));
 			}
 			if ((from << 9) == epsq && !from.on_nth_file(7)) {
-				pl_moves.push_back(Move(from, epsq, from << 1, turn, PAWN, PAWN, NONE, EN_PASSANT));
+				moves.push_back(Move(from, epsq, from << 1, turn, PAWN, PAWN, NONE, EN_PASSANT));
 			}
 		}
 	}
@@ -1069,6 +1533,11 @@ std::vector<Move> Position::move_gen_p(Square from) {
 	if (is_in_check()) {
 		assert(check_vectors.size() == 1); // Only in single check
 		attack_vector = check_vectors[0];
+		// block or capture the checking piece. an e.p. capture resolves the check when the pawn it removes is the checker.
+		moves.erase(std::remove_if(moves.begin() + first, moves.end(), [&](Move& move) {
+			Square test_sq = move.get_to(), capt_sq = move.get_special();
+			return !(attack_vector.contains(test_sq) || (move.get_move_type() == EN_PASSANT && attack_vector.contains(capt_sq)));
+		}), moves.end());
 	}
 	else if (pinned_pieces.contains(from)) {
 		for (auto& test_vector : spy_vectors) {
@@ -1077,28 +1546,45 @@ std::vector<Move> Position::move_gen_p(Square from) {
 				break;
 			}
 		}
-		for (auto& pl_move : pl_moves) {
-			auto test_sq = pl_move.get_to();
-			if (attack_vector.contains(test_sq)) {
-				moves.push_back(pl_move);
-			}
-		}
-	}
-	else {
-		moves = pl_moves;
+		moves.erase(std::remove_if(moves.begin() + first, moves.end(), [&](Move& move) { Square to = move.get_to(); return !attack_vector.contains(to); }), moves.end());
 	}
-	return moves;
+
+	// an e.p. capture removes two pawns from the same rank at once, which can expose the king to a rook or queen on that rank.
+	// that is not a pin that king_threats can see, so check it directly.
+	moves.erase(std::remove_if(moves.begin() + first, moves.end(), [&](Move& move) { return move.get_move_type() == EN_PASSANT && ep_exposes_king(move); }), moves.end());
 }
 
-std::vector<Move> Position::move_gen() {
+bool Position::ep_exposes_king(Move move) {
+	Colors turn = get_turn();
+	Square from = move.get_from(), to = move.get_to(), capt_sq = move.get_special();
+	Square king_sq = pieces_by_type[KING] & pieces_by_color[turn];
+	auto saved_color = pieces_by_color;
+	auto saved_type = pieces_by_type;
+
+	pieces_by_color[turn].clear_square(from);
+	pieces_by_color[turn].mark_square(to);
+	pieces_by_color[!turn].clear_square(capt_sq);
+	pieces_by_type[PAWN].clear_square(from);
+	pieces_by_type[PAWN].mark_square(to);
+	pieces_by_type[PAWN].clear_square(capt_sq);
+
+	bool exposed = square_covered(king_sq);
+
+	pieces_by_color = saved_color;
+	pieces_by_type = saved_type;
+	return exposed;
+}
+
+void Position::move_gen(MoveList& moves) {
+	TRACE_SPAN("move_gen");
 	Colors turn = get_turn();
 	Square from;
 	Bitboard pieces;
 	Types type;
-	std::vector<Move> moves, temp_moves;
+	moves.clear();
 
 	if (checking_pieces.popcount() > 1) { // if in double or more (!!) check...
-		moves = move_gen_k(pieces_by_type[KING] & pieces_by_color[get_turn()]); // Only have to search for King moves
+		move_gen_k(pieces_by_type[KING] & pieces_by_color[get_turn()], moves); // Only have to search for King moves
 	}
 	else {
 		for (int i = 0; i < pieces_by_type.size(); ++i) { // for each piece type...
@@ -1109,19 +1595,25 @@ std::vector<Move> Position::move_gen() {
 				from = pieces.pop_occupied(); // remove the next occupied square from the set of pieces
 				switch (type) { // based on which type of piece this is...
 				case PAWN:
-					temp_moves = move_gen_p(from); // generate pawn moves if its a pawn
+					move_gen_p(from, moves); // generate pawn moves if its a pawn
 					break;
 				case KING:
-					temp_moves = move_gen_k(from); // generate king moves if its a king
+					move_gen_k(from, moves); // generate king moves if its a king
 					break;
 				default:
-					temp_moves = move_gen_sliders(from, type); // generate all the other pieces moves if its neither
+					move_gen_sliders(from, type, moves); // generate all the other pieces moves if its neither
 				}
-				moves.insert(moves.end(), temp_moves.begin(), temp_moves.end()); // append the found moves to the end of the move list
 			}
 		}
 	}
-	return moves;
+	STAT_INC(STAT_MOVE_GEN_CALLS);
+	STAT_ADD(STAT_MOVES_GENERATED, moves.size());
+}
+
+std::vector<Move> Position::move_gen() {
+	MoveList moves;
+	move_gen(moves);
+	return std::vector<Move>(moves.begin(), moves.end());
 }
 
 std::vector<Move> Position::BASIC_pl_move_gen() {
@@ -1343,17 +1835,16 @@ void Position::BASIC_king_threats() {
 
 	++ply; // this simulates a no-move for the current player and makes the move generator provide the opponent's "moves" in the position.
 	std::vector<Move> attacks = BASIC_move_gen();
-	bool in_check = false; // assume not in check to start
+	checking_pieces.clear(); // assume not in check to start
 
-	// check each move for the opponent to see if they "capture" the king
+	// check each move for the opponent to see if they "capture" the king, in check is having a checking piece
 	for (auto& attack : attacks) {
 		if (attack.get_to() == king_sq) {
-			in_check = true;
-			break;
+			Square from = attack.get_from();
+			checking_pieces.mark_square(from);
 		}
 	}
 
-	set_in_check(in_check);
 	--ply;
 	return;
 }
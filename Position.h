@@ -1,10 +1,12 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <array>
 #include <map>
 #include <algorithm>
+#include <type_traits>
 #include "stdint.h"
 #include "Bitboards.h"
 #include "Move.h"
@@ -12,6 +14,11 @@
 #include "Colors.h"
 #include "Utils.h"
 #include "Ray.h"
+#include "Evaluation.h"
+#include "Zobrist.h"
+#include "Nnue.h"
+#include "PackedPosition.h"
+#include "FixedList.h"
 
 // TODO: change methods which have a "void" return type to instead return the Position object which they are called on if they mutate the state of the Position object.
 
@@ -21,6 +28,18 @@ const enum CastleSide {KINGSIDE = 0, QUEENSIDE = 1};
 
 MoveOptions operator|(MoveOptions lhs, MoveOptions rhs);
 
+const size_t MAX_CHECK_VECTORS = 18; // a checker along each of the 8 lines through the king, on each of the 8 knight squares and the 2 pawn squares
+const size_t MAX_SPY_VECTORS = 8; // at most one pin along each line through the king
+
+using DirectionList = FixedList<int, 8>; // square index steps, as in move_directions
+
+const char* const START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"; // standard starting position for chess
+const size_t MAX_FEN_LENGTH = 128; // enough for any FEN to_fen can write, including the terminating null
+
+enum FenErrors { FEN_OK = 0, FEN_BAD_BOARD, FEN_BAD_KINGS, FEN_BAD_TURN, FEN_BAD_CASTLING, FEN_BAD_EP, FEN_BAD_CLOCKS };
+
+const char* fen_error_message(FenErrors error);
+
 struct perft_moves {
 	int moves;
 	int capts;
@@ -30,8 +49,11 @@ struct perft_moves {
 	int checks;
 };
 
-class Position {
-private:
+const size_t CACHE_LINE = 64;
+
+// The board itself, which is all make_move changes directly. A copy is saved before each move, so that undo can put it
+// straight back: it holds nothing on the heap and fits two cache lines, so saving it is one small memcpy.
+struct alignas(CACHE_LINE) PositionState {
 	// index these bitboard arrays with the enums defined above!
 	std::array<Bitboard, 2> pieces_by_color; // array of bitboards, [0] for white pieces, [1] for black pieces
 	std::array<Bitboard, 6> pieces_by_type; // array of bitboards, [0] pawns, [1] knights, [2] bishops, [3] rooks, [4] queens, [5] kings
@@ -40,21 +62,62 @@ private:
 
 	uint16_t ply; // count of the current ply
 	uint16_t ply_clock; // number of plys that have been played since the last capture or pawn move
+	uint16_t plies_from_null; // plies played since the last null move or since the position was loaded, whichever is nearer
 	uint8_t flags;	// 4 bits for castling rights (0bxxx1-WK, 0bxx1x-WQ, 0bx1xx-BK, 0b1xxx-BQ)
-					// 1 bit for in-check status (0b1-Check, 0b0-No Check)
-					// 3 bonus bits!
+					// 4 bonus bits!
 
+	int mg_score; // material + piece-square score with middlegame weights, from white's point of view. updated incrementally by make_move.
+	int eg_score; // same, with endgame weights
+	int phase; // sum of phase_weights over the pieces on the board, for tapering between mg_score and eg_score
+
+	uint64_t key; // Zobrist key of the whole position, updated incrementally by make_move
+	uint64_t pawn_key; // Zobrist key of the pawns alone, only changes when a pawn moves, is captured or promotes
+};
+
+static_assert(std::is_trivially_copyable<PositionState>::value && sizeof(PositionState) <= 2 * CACHE_LINE, "PositionState is saved by plain copy");
+
+// The checks and pins against the side to move's king, which king_threats works out from the board after every move. Kept
+// apart from PositionState, with a history of its own, so that the board stays small.
+struct KingThreats {
 	Bitboard checking_pieces; // bitboard of squares that are occupied by a piece which is checking the king
 	Bitboard spying_pieces;	// bitboard of squares that are occupied by a piece which is "spying on" the king
 	Bitboard pinned_pieces;	// bitboard of squares that are occupied by pinned pieces
-	std::vector<Bitboard> check_vectors; // array of bitboards containing squares between checking pieces and the king
-	std::vector<Bitboard> spy_vectors; // array of bitboards containing squares between spying pieces and the king
+	FixedList<Bitboard, MAX_CHECK_VECTORS> check_vectors; // array of bitboards containing squares between checking pieces and the king
+	FixedList<Bitboard, MAX_SPY_VECTORS> spy_vectors; // array of bitboards containing squares between spying pieces and the king
+};
 
+// What gives_check needs to know about a position, worked out once for all of its moves
+struct CheckInfo {
+	unsigned int king_sq; // the king of the side not to move
+	std::array<uint64_t, 6> check_squares; // indexed by type, the squares a piece of the side to move would give check from
+	uint64_t candidates; // the side to move's pieces that block one of its own sliders from that king, so moving can uncover a check
+};
 
-	std::vector<Move> move_gen_p(Square from);
-	std::vector<Move> move_gen_k(Square from);
-	std::vector<Move> move_gen_sliders(Square from, Types type);
-	std::vector<Move> move_gen_generic(Square from, std::vector<int> directions, int max_distance = -1, MoveOptions move_opts = (MoveOptions::PLACE | MoveOptions::CAPT));
+class Position : private PositionState, private KingThreats {
+private:
+	std::vector<PositionState> state_history; // the state before each move made on this position, most recent last
+	std::vector<KingThreats> threat_history; // the threats before each move, alongside state_history
+	std::vector<Move> move_history; // the moves made on this position, in the order they were played
+	std::vector<uint64_t> key_history; // the key before each move, alongside state_history but cheap to scan for repetitions
+
+	AccumulatorStack* accumulators; // network accumulators kept in step by make_move / undo, nullptr when the network is not in use
+
+	void put_piece(Colors color, Types type, Square sq);
+	void remove_piece(Colors color, Types type, Square sq);
+	void refresh_eval();
+	void refresh_keys();
+	void update_state_key(uint8_t old_flags, Square old_epsq);
+	void load(const std::array<uint64_t, 2>& colors, const std::array<uint64_t, 6>& types, bool white, uint8_t castling, int ep_index,
+		unsigned int ply_count, unsigned int move_number);
+
+
+	// the generators append to moves
+	void move_gen_p(Square from, MoveList& moves);
+	void move_gen_k(Square from, MoveList& moves);
+	void move_gen_sliders(Square from, Types type, MoveList& moves);
+	void move_gen_generic(Square from, const DirectionList& directions, MoveList& moves, int max_distance = -1, MoveOptions move_opts = (MoveOptions::PLACE | MoveOptions::CAPT));
+	bool ep_exposes_king(Move move);
+	unsigned int count_legal_moves(bool stop_at_first);
 
 	// Implementing a simpler movegen algorithm in hopes that it will be more correct, and to aid in debugging. These methods are to support that effort.
 	std::vector<Move> BASIC_pl_move_gen();
@@ -64,13 +127,22 @@ private:
 
 public:
 	// Constructors
-	Position(std::string fen) { parse_fen(fen); }
-	Position() : Position("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1") {} // default standard starting position for chess, in FEN notation
+	Position(std::string_view fen); // falls back to the starting position if the FEN does not parse
+	Position() : Position(START_FEN) {} // default standard starting position for chess, in FEN notation
 
 	// Methods
-	void parse_fen(std::string fen);
-	//TODO std::string gen_fen();
+	FenErrors parse_fen(std::string_view fen); // on error the position is left exactly as it was
+	size_t to_fen(char* buffer, size_t size); // writes a null terminated FEN, returns its length, or 0 if it does not fit
+	std::string to_fen();
+	bool pack(PackedPosition& packed); // false if there are more pieces than the record has room for
+	bool unpack(const PackedPosition& packed); // false, leaving the position unchanged, if the record is not a valid position
+	void move_gen(MoveList& moves); // the legal moves, replacing what moves held
 	std::vector<Move> move_gen();
+	bool has_legal_move(); // stops at the first legal move it finds, for telling mate and stalemate from the rest
+	unsigned int count_legal(); // the number of legal moves, without generating them
+	CheckInfo check_info();
+	bool gives_check(Move move, const CheckInfo& info); // move must be legal here
+	bool gives_check(Move move);
 	static void disp_bitboard(Bitboard bb, std::string title, char piece_c, char empty_c);
 	static void disp_bitboard(Bitboard bb, std::string title);
 	static void disp_bitboard(Bitboard bb);
@@ -88,7 +160,6 @@ public:
 	bool square_covered(Square sq);
 	bool attacked_by_piece(Square sq, Types piece_type);
 	void king_threats();
-	void set_in_check(bool set);
 	void disp_bitboards();
 	void disp_castling();
 	void disp_epsq();
@@ -97,8 +168,26 @@ public:
 	void disp() { disp(false); };
 	Position& make_move(Move move);
 	Position& undo();
+	Position& make_null_move();
+	Position& undo_null_move();
+	void reserve_history(size_t plies); // room for that many more moves, so that make_move does not have to grow the history
 	void perft(unsigned int depth, perft_moves& counts);
+	uint64_t perft(unsigned int depth); // leaf count only, the last ply is counted without being played
+	bool is_draw(int ply_from_root);
+	bool has_game_cycle(int ply_from_root);
 	Bitboard get_occupied();
+	Bitboard get_pieces(Colors color, Types type);
+	int get_mg_score() { return mg_score; }
+	int get_eg_score() { return eg_score; }
+	int get_phase() { return phase; }
+	int get_ply() { return ply; }
+	uint16_t get_ply_clock() { return ply_clock; }
+	uint8_t get_castling() { return flags & 0b1111; } // the four castling right bits, K Q k q from the lowest
+	Square get_ep_square() { return epsq; }
+	uint64_t get_key() { return key; }
+	uint64_t get_pawn_key() { return pawn_key; }
+	void attach_accumulators(AccumulatorStack* stack);
+	AccumulatorStack* get_accumulators() { return accumulators; }
 
 	// Implementing a simpler movegen algorithm in hopes that it will be more correct, and to aid in debugging. These methods are to support that effort.
 	std::vector<Move> BASIC_move_gen();
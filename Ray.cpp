@@ -45,7 +45,11 @@ Square Ray::get_prev() {
 	}
 }
 
-void Ray::update_maxed() { this->maxed = (distance == 0) || (this->current & move_masks[direction]).is_empty(); }
+// find rather than operator[], which would insert missing directions and make the shared map unsafe to read from several threads
+void Ray::update_maxed() {
+	auto mask = move_masks.find(direction);
+	this->maxed = (distance == 0) || mask == move_masks.end() || (this->current & mask->second).is_empty();
+}
 
 int Ray::NO_DIR = 0;
 int Ray::NO_MAX = -1;
@@ -0,0 +1,390 @@
+#include "Search.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Tablebase.h"
+#include <cmath>
+#include <algorithm>
+
+// Filled in during static initialisation, before any thread can construct a Search
+const Search::ReductionTable Search::reductions = Search::init_reductions();
+
+const std::array<int, 4> futility_margins = { 0, 200, 300, 500 }; // indexed by remaining depth
+
+// Reductions grow with the log of both the depth and how late the move comes in the ordering.
+Search::ReductionTable Search::init_reductions() {
+	ReductionTable reductions;
+	for (int depth = 0; depth < MAX_REDUCTION_DEPTH; ++depth) {
+		for (int index = 0; index < MAX_REDUCTION_INDEX; ++index) {
+			if (depth == 0 || index == 0) {
+				reductions[depth][index] = 0;
+			}
+			else {
+				reductions[depth][index] = int(0.75 + std::log(depth) * std::log(index) / 2.25);
+			}
+		}
+	}
+	return reductions;
+}
+
+Search::Search(Position pos, SearchOptions options) : pos(pos), options(options), frames(MAX_PLY), nodes(0), stopped(false), stop_requested(false), pondering(false) {
+	set_position(pos);
+}
+
+void Search::set_position(Position pos) {
+	this->pos = pos;
+	this->pos.reserve_history(MAX_PLY); // the deepest line the search can play out
+	if (options.use_nnue && get_network()) {
+		// the stack keeps a reference to the network it was built for, which a reload replaces
+		if (!accumulators || &accumulators->get_network() != get_network()) {
+			accumulators.reset(new AccumulatorStack(*get_network()));
+		}
+		this->pos.attach_accumulators(accumulators.get());
+	}
+}
+
+void Search::clear() {
+	order.clear();
+	pawn_table.clear();
+	tt.clear();
+}
+
+int Search::evaluate() {
+	return ::evaluate(pos, pawn_table);
+}
+
+// A null move can only be trusted when passing is worse than any real move, which stops being true when the side to move has
+// little left besides its king and pawns. With two or fewer pieces, null-move cutoffs are verified with a real search.
+bool Search::zugzwang_prone() {
+	Colors turn = pos.get_turn();
+	int pieces = 0;
+	for (int i = KNIGHT; i <= QUEEN; ++i) {
+		pieces += pos.get_pieces(turn, static_cast<Types>(i)).popcount();
+	}
+	return pieces <= 2;
+}
+
+// Mate scores are stored relative to the node rather than the root, so that they stay correct when the same position
+// is reached at a different ply.
+int score_to_tt(int score, int ply) {
+	if (score >= MATE_BOUND) { return score + ply; }
+	if (score <= -MATE_BOUND) { return score - ply; }
+	return score;
+}
+
+int score_from_tt(int score, int ply) {
+	if (score >= MATE_BOUND) { return score - ply; }
+	if (score <= -MATE_BOUND) { return score + ply; }
+	return score;
+}
+
+// A tablebase result as a score at this ply: mates count from the root like the search's own. A mate further from the
+// root than MAX_PLY would fall below MATE_BOUND, so it is reported as a win of unknown distance instead.
+int tablebase_score(const TbResult& result, int ply) {
+	if (result.wdl == 0) { return 0; }
+	bool mate_fits = result.plies >= 0 && ply + result.plies < MAX_PLY;
+	int score = mate_fits ? MATE_SCORE - (ply + result.plies) : TB_WIN_SCORE - ply;
+	return result.wdl > 0 ? score : -score;
+}
+
+bool Search::should_stop() {
+	if (stopped) { return true; }
+	if (limits.nodes != 0 && nodes >= limits.nodes) {
+		stopped = true;
+	}
+	else if ((nodes & 1023) == 0) { // reading the clock or the shared flags every node would cost more than the node itself
+		if (stop_requested) {
+			stopped = true;
+		}
+		else if (!pondering && time.hard_limit_reached()) {
+			stopped = true;
+		}
+	}
+	return stopped;
+}
+
+// Follows the hash moves from the root for as long as they are legal. The root move is the one the search chose,
+// the rest may have been overwritten and are only as good as the table.
+std::vector<Move> Search::extract_pv(int max_length) {
+	std::vector<Move> pv;
+	Move move = root_best;
+
+	while (!move.is_null() && int(pv.size()) < max_length) {
+		pos.make_move(move);
+		pv.push_back(move);
+
+		TTEntry entry;
+		move = Move();
+		if (tt.probe(pos.get_key(), entry) && entry.has_move()) {
+			Move hash_move = entry.get_move(pos.get_turn());
+			for (auto& legal : pos.move_gen()) {
+				if (legal == hash_move) { move = legal; break; }
+			}
+		}
+	}
+	for (unsigned int i = 0; i < pv.size(); ++i) {
+		pos.undo();
+	}
+	return pv;
+}
+
+SearchResult Search::think(SearchLimits limits) {
+	SearchResult result = { Move(), 0, 0, 0, {} };
+	auto start = std::chrono::steady_clock::now();
+
+	this->limits = limits;
+	nodes = 0;
+	stopped = false;
+	time.init(limits, pos.get_turn());
+	order.clear_killers();
+
+	for (int depth = 1; depth <= limits.depth && depth < MAX_PLY; ++depth) {
+		TRACE_SPAN("search_iteration", depth);
+		root_best = Move();
+		int score = negamax(depth, -INF_SCORE, INF_SCORE, 0, true);
+
+		if (stopped && depth > 1) { // a partial iteration can not be trusted, keep the result of the last complete one
+			break;
+		}
+
+		result.best_move = root_best;
+		result.score = score;
+		result.depth = depth;
+		result.pv = extract_pv(depth);
+		result.iterations.push_back({ depth, score, nodes, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), root_best, result.pv });
+		if (reporter) { reporter(result.iterations.back()); }
+
+		if (root_best.is_null() || stopped) { // no legal moves at the root, or out of nodes before finishing even the first iteration
+			break;
+		}
+
+		time.update(depth, root_best, score);
+		if (!pondering && time.stop_iterating()) {
+			break;
+		}
+	}
+	if (result.best_move.is_null()) { // stopped before the first iteration got through a single root move
+		std::vector<Move> moves = pos.move_gen();
+		if (!moves.empty()) { result.best_move = moves[0]; }
+	}
+	result.nodes = nodes;
+	return result;
+}
+
+int Search::negamax(int depth, int alpha, int beta, int ply, bool null_allowed) {
+	// in a tablebase position the result is known exactly, so there is nothing left to search. The root still searches, to pick the move
+	TbResult tb_result;
+	if (ply > 0 && tablebase_pieces() > 0 && pos.get_occupied().popcount() <= int(tablebase_pieces()) && probe_tablebase(pos, tb_result)) {
+		return tablebase_score(tb_result, ply);
+	}
+
+	// a repetition or the fifty move rule ends the game here. A move back to an earlier position of the search is at least a
+	// draw for the side to move, so alpha can come up to it before that move is even searched
+	if (ply > 0) {
+		if (pos.is_draw(ply)) {
+			return 0;
+		}
+		if (alpha < 0 && pos.has_game_cycle(ply)) {
+			alpha = 0;
+			if (alpha >= beta) { return alpha; }
+		}
+	}
+
+	if (depth <= 0) {
+		return quiesce(alpha, beta, ply);
+	}
+
+	++nodes;
+	STAT_INC(STAT_NODES);
+	if (should_stop()) { return 0; }
+	if (ply >= MAX_PLY - 1) { return evaluate(); }
+
+	bool pv_node = (beta - alpha) > 1;
+	int alpha_orig = alpha;
+	uint64_t key = pos.get_key();
+
+	TTEntry entry;
+	Move hash_move;
+	if (tt.probe(key, entry)) {
+		if (entry.has_move()) { hash_move = entry.get_move(pos.get_turn()); }
+		if (!pv_node && entry.depth >= depth) {
+			int tt_score = score_from_tt(entry.score, ply);
+			if (entry.bound == BOUND_EXACT || (entry.bound == BOUND_LOWER && tt_score >= beta) || (entry.bound == BOUND_UPPER && tt_score <= alpha)) {
+				STAT_INC(STAT_TT_CUTOFFS);
+				return tt_score;
+			}
+		}
+	}
+
+	bool in_check = pos.is_in_check();
+	int static_eval = evaluate();
+
+	// Reverse futility pruning: so far above beta that a shallow search is not going to bring it back down.
+	if (options.reverse_futility && !pv_node && !in_check && depth <= 6 && std::abs(beta) < MATE_BOUND && static_eval - 90 * depth >= beta) {
+		return static_eval;
+	}
+
+	// Null-move pruning: give the opponent a free move. If a reduced search still fails high, a real move would do even better.
+	if (options.null_move && null_allowed && !pv_node && !in_check && depth >= 3 && static_eval >= beta && ply > 0) {
+		bool has_pieces = false;
+		for (int i = KNIGHT; i <= QUEEN; ++i) {
+			has_pieces |= !pos.get_pieces(pos.get_turn(), static_cast<Types>(i)).is_empty();
+		}
+
+		if (has_pieces) { // king and pawn endings are full of zugzwang, never pass in them
+			int reduction = 3 + depth / 6;
+			ply_moves[ply] = Move();
+			pos.make_null_move();
+			int score = -negamax(depth - 1 - reduction, -beta, -beta + 1, ply + 1, false);
+			pos.undo_null_move();
+
+			if (stopped) { return 0; }
+			if (score >= beta) {
+				if (score >= MATE_BOUND) { score = beta; } // a mate found after passing is not a real mate
+				if (!options.null_verification || !zugzwang_prone()) {
+					return score;
+				}
+				if (negamax(depth - 1 - reduction, beta - 1, beta, ply, false) >= beta) {
+					return score;
+				}
+			}
+		}
+	}
+
+	SearchFrame& frame = frames[ply];
+	MoveList& moves = frame.moves;
+	pos.move_gen(moves);
+	if (moves.empty()) {
+		return in_check ? -MATE_SCORE + ply : 0; // checkmate or stalemate
+	}
+
+	MoveScores& scores = frame.scores;
+	MoveList& quiets_tried = frame.quiets_tried;
+	quiets_tried.clear();
+	frame.checks = pos.check_info();
+	Move prev_move = (ply > 0) ? ply_moves[ply - 1] : Move();
+	order.score_moves(moves, scores, hash_move, prev_move, ply);
+
+	// Futility pruning: this node is so far below alpha that quiet moves are not going to raise it.
+	bool futile = options.futility && !pv_node && !in_check && depth < int(futility_margins.size()) && std::abs(alpha) < MATE_BOUND
+		&& static_eval + futility_margins[depth] <= alpha;
+
+	int best_score = -INF_SCORE;
+	Move best_move;
+	for (unsigned int i = 0; i < moves.size(); ++i) {
+		Move move = MoveOrder::pick_next(moves, scores, i);
+		bool quiet = !move.is_capture() && move.get_move_type() != PROMOTION;
+		bool first_searched = (best_score == -INF_SCORE);
+
+		// Late move pruning: at shallow depth, after enough quiet moves, the rest are ordered too late to matter.
+		if (options.late_move_pruning && quiet && !pv_node && !in_check && !first_searched && depth <= 4 && best_score > -MATE_BOUND
+			&& int(quiets_tried.size()) >= 3 + depth * depth) {
+			continue;
+		}
+
+		// a futile quiet move is skipped unless it checks, which is known without making it
+		bool gives_check = pos.gives_check(move, frame.checks);
+		if (futile && quiet && !gives_check && !first_searched) {
+			continue;
+		}
+
+		ply_moves[ply] = move;
+		pos.make_move(move);
+		STAT_INC(STAT_MOVES_SEARCHED);
+
+		int score;
+		if (first_searched) {
+			score = -negamax(depth - 1, -beta, -alpha, ply + 1, true);
+		}
+		else {
+			// Late move reductions: quiet moves ordered late are searched shallower with a null window.
+			int reduction = 0;
+			if (options.late_move_reductions && quiet && !in_check && !gives_check && depth >= 3 && i >= 3) {
+				reduction = reductions[std::min(depth, MAX_REDUCTION_DEPTH - 1)][std::min(int(i), MAX_REDUCTION_INDEX - 1)];
+				if (pv_node) { --reduction; }
+				if (order.is_killer(move, ply)) { --reduction; }
+				reduction = std::max(0, std::min(reduction, depth - 2));
+			}
+
+			score = -negamax(depth - 1 - reduction, -alpha - 1, -alpha, ply + 1, true);
+			if (score > alpha && reduction > 0) { // beat alpha at reduced depth, verify at full depth
+				score = -negamax(depth - 1, -alpha - 1, -alpha, ply + 1, true);
+			}
+			if (score > alpha && score < beta) { // and inside the window, get an exact score
+				score = -negamax(depth - 1, -beta, -alpha, ply + 1, true);
+			}
+		}
+		pos.undo();
+
+		if (stopped) { return 0; }
+
+		if (score > best_score) {
+			best_score = score;
+			if (ply == 0) { root_best = move; }
+			if (score > alpha) {
+				alpha = score;
+				best_move = move;
+				if (alpha >= beta) {
+					if (quiet) { order.update_quiet(move, quiets_tried, prev_move, ply, depth); }
+					STAT_INC(STAT_BETA_CUTOFFS);
+					STAT_INC(cutoff_bin(i));
+					break;
+				}
+			}
+		}
+		if (quiet) { quiets_tried.push_back(move); }
+	}
+
+	Bounds bound = (best_score >= beta) ? BOUND_LOWER : (best_score > alpha_orig) ? BOUND_EXACT : BOUND_UPPER;
+	tt.store(key, depth, score_to_tt(best_score, ply), bound, best_move);
+	return best_score;
+}
+
+// Searches captures and promotions only, until the position is quiet, so that the static eval is never taken in the middle of an exchange.
+// When in check every evasion is searched instead, since standing pat is not an option.
+int Search::quiesce(int alpha, int beta, int ply) {
+	++nodes;
+	STAT_INC(STAT_QNODES);
+	if (should_stop()) { return 0; }
+	if (ply >= MAX_PLY - 1) { return evaluate(); }
+
+	bool in_check = pos.is_in_check();
+	int best_score = -INF_SCORE;
+
+	if (!in_check) {
+		int stand_pat = evaluate();
+		if (stand_pat >= beta) { return stand_pat; }
+		if (stand_pat > alpha) { alpha = stand_pat; }
+		best_score = stand_pat;
+	}
+
+	MoveList& moves = frames[ply].moves;
+	pos.move_gen(moves);
+	if (in_check && moves.empty()) {
+		return -MATE_SCORE + ply;
+	}
+	if (!in_check) {
+		moves.erase(std::remove_if(moves.begin(), moves.end(), [](Move& move) { return !move.is_capture() && move.get_move_type() != PROMOTION; }), moves.end());
+	}
+
+	MoveScores& scores = frames[ply].scores;
+	order.score_moves(moves, scores, Move(), Move(), std::min(ply, MAX_PLY - 1));
+
+	for (unsigned int i = 0; i < moves.size(); ++i) {
+		Move move = MoveOrder::pick_next(moves, scores, i);
+		pos.make_move(move);
+		STAT_INC(STAT_MOVES_SEARCHED);
+		int score = -quiesce(-beta, -alpha, ply + 1);
+		pos.undo();
+
+		if (stopped) { return 0; }
+
+		if (score > best_score) {
+			best_score = score;
+			if (score > alpha) {
+				alpha = score;
+				if (alpha >= beta) { break; }
+			}
+		}
+	}
+	return best_score;
+}
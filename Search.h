@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include "stdint.h"
+#include "Position.h"
+#include "MoveOrder.h"
+#include "Pawns.h"
+#include "TranspositionTable.h"
+#include "TimeManager.h"
+
+const int INF_SCORE = 32001;
+const int MATE_SCORE = 32000; // mate in n plies is scored as MATE_SCORE - n
+const int MATE_BOUND = MATE_SCORE - MAX_PLY; // any score beyond this is a forced mate
+const int TB_WIN_SCORE = MATE_BOUND - MAX_PLY; // a tablebase win whose distance to mate is not known, below every mate score
+
+// Each of the selective search techniques can be switched off on its own, so that its effect on time to depth can be measured.
+struct SearchOptions {
+	bool null_move = true; // null-move pruning: pass the turn, and if a reduced search still fails high, prune the node
+	bool null_verification = true; // re-search null-move cutoffs without the null move in zugzwang-prone endgames
+	bool late_move_reductions = true; // search late quiet moves at a reduced depth, re-searching if they beat alpha
+	bool reverse_futility = true; // prune shallow nodes whose static eval is far above beta
+	bool futility = true; // skip quiet moves at shallow nodes whose static eval is far below alpha
+	bool late_move_pruning = true; // skip the remaining quiet moves at shallow nodes after enough of them have been tried
+	bool use_nnue = true; // evaluate with the network instead of the hand written terms, when one has been loaded
+};
+
+// Any combination of limits can be given, the search stops at whichever is reached first. 0 is no limit.
+struct SearchLimits {
+	int depth = MAX_PLY - 1;
+	uint64_t nodes = 0;
+	int64_t movetime = 0; // milliseconds for this move
+	std::array<int64_t, 2> time = { 0, 0 }; // milliseconds left on each side's clock, indexed by color
+	std::array<int64_t, 2> increment = { 0, 0 };
+	int movestogo = 0; // moves until the next time control, 0 for sudden death
+	bool infinite = false; // search until stopped
+	bool ponder = false; // searching on the opponent's time, the clock only starts counting after ponderhit
+};
+
+// Stats for one completed iteration of iterative deepening
+struct SearchIteration {
+	int depth;
+	int score;
+	uint64_t nodes;
+	double seconds;
+	Move best_move;
+	std::vector<Move> pv; // principal variation, read back from the transposition table
+};
+
+struct SearchResult {
+	Move best_move;
+	int score;
+	int depth;
+	uint64_t nodes;
+	std::vector<SearchIteration> iterations;
+	std::vector<Move> pv;
+};
+
+// Scratch space for one node. A Search allocates a frame per ply when it is made, and each node works in the frame of its
+// own ply, so nothing on the search path touches the heap.
+struct SearchFrame {
+	MoveList moves;
+	MoveScores scores;
+	MoveList quiets_tried;
+	CheckInfo checks; // for telling the checking moves apart before they are made
+};
+
+class Search {
+private:
+	static const int MAX_REDUCTION_DEPTH = 64;
+	static const int MAX_REDUCTION_INDEX = 64;
+	using ReductionTable = std::array<std::array<int, MAX_REDUCTION_INDEX>, MAX_REDUCTION_DEPTH>;
+	static const ReductionTable reductions; // late move reductions, indexed [depth][move index]
+	static ReductionTable init_reductions();
+
+	Position pos;
+	SearchOptions options;
+	SearchLimits limits;
+	MoveOrder order;
+	PawnTable pawn_table;
+	TranspositionTable tt;
+	std::unique_ptr<AccumulatorStack> accumulators;
+	std::array<Move, MAX_PLY> ply_moves; // the move made at each ply of the current line, for the countermove table
+	std::vector<SearchFrame> frames; // indexed by ply, never resized after the constructor
+	Move root_best;
+	uint64_t nodes;
+	bool stopped;
+
+	// Set from other threads while a search is running
+	std::atomic<bool> stop_requested;
+	std::atomic<bool> pondering;
+	TimeManager time;
+	std::function<void(SearchIteration&)> reporter;
+
+	int negamax(int depth, int alpha, int beta, int ply, bool null_allowed);
+	int quiesce(int alpha, int beta, int ply);
+	int evaluate();
+	bool zugzwang_prone();
+	bool should_stop();
+	std::vector<Move> extract_pv(int max_length);
+
+public:
+	Search(Position pos, SearchOptions options = SearchOptions());
+
+	void set_position(Position pos);
+	SearchResult think(SearchLimits limits);
+	void clear(); // forget everything learned from earlier searches, for a new game
+	void set_reporter(std::function<void(SearchIteration&)> reporter) { this->reporter = reporter; }
+
+	// Safe to call from another thread while think() is running. Neither is reset by think(), so a stop that arrives
+	// before the search thread has even started is not lost: call reset_signals() before starting the thread instead.
+	void reset_signals(bool ponder) { stop_requested = false; pondering = ponder; }
+	void stop() { stop_requested = true; }
+	void ponderhit() { time.ponderhit(); pondering = false; } // the clock restarts before the limits are allowed to apply
+	bool is_stop_requested() { return stop_requested; }
+	bool is_pondering() { return pondering; }
+
+	PawnTable& get_pawn_table() { return pawn_table; }
+	TranspositionTable& get_tt() { return tt; }
+	TimeManager& get_time() { return time; }
+};
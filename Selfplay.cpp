@@ -0,0 +1,176 @@
+#include "Selfplay.h"
+#include "Position.h"
+#include "Search.h"
+#include "Polyglot.h"
+#include "Tablebase.h"
+#include "Parallel.h"
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+// Only kings, or kings and a single minor piece: nobody can mate
+bool insufficient_material(Position& pos) {
+	int pieces = pos.get_occupied().popcount();
+	if (pieces == 2) { return true; }
+	if (pieces != 3) { return false; }
+	for (int color = 0; color < 2; ++color) {
+		if (!pos.get_pieces(static_cast<Colors>(color), KNIGHT).is_empty() || !pos.get_pieces(static_cast<Colors>(color), BISHOP).is_empty()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Book moves while the book has any, then random_plies random moves. Openings that end the game are played again.
+Position play_opening(const SelfplayOptions& options, PolyglotBook* book, std::mt19937_64& random) {
+	while (true) {
+		Position pos;
+		Move move;
+		while (book && book->pick_move(pos, move, random)) {
+			pos.make_move(move);
+		}
+		bool finished = false;
+		for (unsigned int ply = 0; ply < options.random_plies && !finished; ++ply) {
+			std::vector<Move> moves = pos.move_gen();
+			finished = moves.empty();
+			if (!finished) { pos.make_move(moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(random)]); }
+		}
+		if (!finished && pos.has_legal_move()) {
+			return pos;
+		}
+	}
+}
+
+std::vector<PackedPosition> play_selfplay_game(const SelfplayOptions& options, unsigned int game, PolyglotBook* book) {
+	std::mt19937_64 random(options.seed + game);
+	Position pos = play_opening(options, book, random);
+
+	Search search{ pos };
+	search.get_tt().resize(options.hash_mb);
+	SearchLimits limits;
+	if (options.depth > 0) { limits.depth = options.depth; }
+	if (options.nodes > 0) { limits.nodes = options.nodes; }
+	if (options.depth <= 0 && options.nodes == 0) { limits.depth = 6; }
+
+	std::vector<PackedPosition> positions;
+	uint8_t result = PackedPosition::RESULT_DRAW;
+	unsigned int winning_streak = 0, drawn_streak = 0;
+	int leader = 0; // +1 while white has been ahead by resign_score in every search of the streak, -1 for black
+	for (unsigned int ply = 0; ; ++ply) {
+		Colors turn = pos.get_turn();
+		if (!pos.has_legal_move()) {
+			if (pos.is_in_check()) { result = (turn == WHITE) ? PackedPosition::RESULT_BLACK_WINS : PackedPosition::RESULT_WHITE_WINS; }
+			break;
+		}
+		if (pos.is_draw(0) || insufficient_material(pos) || ply >= options.max_plies) {
+			break;
+		}
+		TbResult tb;
+		if (probe_tablebase(pos, tb)) {
+			if (tb.wdl != 0) { result = ((tb.wdl > 0) == (turn == WHITE)) ? PackedPosition::RESULT_WHITE_WINS : PackedPosition::RESULT_BLACK_WINS; }
+			break;
+		}
+
+		search.set_position(pos);
+		SearchResult searched = search.think(limits);
+		if (searched.best_move.is_null()) {
+			break;
+		}
+		PackedPosition packed;
+		if (pos.pack(packed)) {
+			packed.label = static_cast<int16_t>(std::max(-MATE_SCORE, std::min(MATE_SCORE, searched.score)));
+			positions.push_back(packed);
+		}
+
+		// adjudication, on the score from white's point of view
+		int score = (turn == WHITE) ? searched.score : -searched.score;
+		int ahead = score >= options.resign_score ? 1 : score <= -options.resign_score ? -1 : 0;
+		winning_streak = (ahead != 0 && ahead == leader) ? winning_streak + 1 : (ahead != 0 ? 1 : 0);
+		leader = ahead;
+		drawn_streak = (ply + 1 >= options.draw_after && std::abs(score) <= options.draw_score) ? drawn_streak + 1 : 0;
+		if (winning_streak >= options.resign_plies) {
+			result = (leader > 0) ? PackedPosition::RESULT_WHITE_WINS : PackedPosition::RESULT_BLACK_WINS;
+			break;
+		}
+		if (drawn_streak >= options.draw_plies) {
+			break;
+		}
+
+		pos.make_move(searched.best_move);
+	}
+
+	for (auto& packed : positions) {
+		packed.state |= static_cast<uint8_t>(result << PackedPosition::RESULT_SHIFT);
+	}
+	return positions;
+}
+
+int selfplay_main(int argc, char* argv[]) {
+	const char* usage = "usage: selfplay <out.bin> [games <n>] [threads <n>] [depth <n>] [nodes <n>] [hash <mb>] [book <file.bin>] [random <plies>] [seed <n>] [tablebases <dir>]";
+	if (argc < 2) {
+		std::cerr << usage << std::endl;
+		return 2;
+	}
+	SelfplayOptions options;
+	options.threads = default_thread_count();
+	for (int i = 2; i + 1 < argc; i += 2) {
+		std::string option = argv[i], value = argv[i + 1];
+		bool valid = true;
+		if (option == "games") { valid = parse_number(value, options.games); }
+		else if (option == "threads") { valid = parse_number(value, options.threads); }
+		else if (option == "depth") { valid = parse_number(value, options.depth); }
+		else if (option == "nodes") { valid = parse_number(value, options.nodes); }
+		else if (option == "hash") { valid = parse_number(value, options.hash_mb); }
+		else if (option == "book") { options.book_path = value; }
+		else if (option == "random") { valid = parse_number(value, options.random_plies); }
+		else if (option == "seed") { valid = parse_number(value, options.seed); }
+		else if (option == "tablebases") { options.tablebase_path = value; }
+		if (!valid) {
+			std::cerr << usage << std::endl;
+			return 2;
+		}
+	}
+	options.threads = std::max(1u, options.threads);
+	options.hash_mb = std::max<size_t>(1, options.hash_mb);
+
+	PolyglotBook book;
+	if (!options.book_path.empty() && !book.open(options.book_path)) {
+		std::cerr << "could not load book " << options.book_path << std::endl;
+		return 2;
+	}
+	if (!options.tablebase_path.empty()) {
+		std::cout << load_tablebases(options.tablebase_path) << " tablebases loaded from " << options.tablebase_path << std::endl;
+	}
+	std::ofstream out(argv[1], std::ios::binary | std::ios::app);
+	if (!out) {
+		std::cerr << "could not open " << argv[1] << std::endl;
+		return 2;
+	}
+
+	// games finish in any order, each is written whole as soon as it is over
+	std::mutex output;
+	SelfplayStats stats;
+	auto start = std::chrono::steady_clock::now();
+	parallel_for(options.games, options.threads, [&](size_t game) {
+		std::vector<PackedPosition> positions = play_selfplay_game(options, static_cast<unsigned int>(game), book.is_open() ? &book : nullptr);
+		uint8_t result = positions.empty() ? PackedPosition::RESULT_DRAW : static_cast<uint8_t>(positions[0].state >> PackedPosition::RESULT_SHIFT);
+
+		std::lock_guard<std::mutex> lock(output);
+		out.write(reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(PackedPosition));
+		++stats.games;
+		stats.white_wins += result == PackedPosition::RESULT_WHITE_WINS;
+		stats.draws += result == PackedPosition::RESULT_DRAW;
+		stats.black_wins += result == PackedPosition::RESULT_BLACK_WINS;
+		stats.positions += positions.size();
+	});
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << stats.games << " games (+" << stats.white_wins << " =" << stats.draws << " -" << stats.black_wins << "), "
+		<< stats.positions << " positions in " << seconds << " s on " << options.threads << " threads, "
+		<< uint64_t(seconds > 0 ? stats.games * 3600 / seconds : 0) << " games per hour" << std::endl;
+	return out ? 0 : 2;
+}
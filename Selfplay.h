@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "stdint.h"
+#include "PackedPosition.h"
+
+class PolyglotBook;
+
+// How self-play games are started, searched and cut short
+struct SelfplayOptions {
+	unsigned int games = 100;
+	unsigned int threads = 1; // games played at once, one per thread
+	int depth = 0; // search depth per move, 0 for none
+	uint64_t nodes = 0; // search nodes per move, 0 for none. With neither set, depth 6 is used
+	size_t hash_mb = 16; // transposition table per game
+	std::string book_path; // Polyglot book to start games from, empty for none
+	unsigned int random_plies = 8; // random moves after the book runs out, so that games differ
+	uint64_t seed = 1; // game n plays from the generator seeded with seed + n, so every game can be played again on its own
+	std::string tablebase_path; // tablebases to adjudicate with, empty for none
+	unsigned int max_plies = 400; // a game this long is a draw
+	int resign_score = 1000; // one side is this far ahead, in centipawns, ...
+	unsigned int resign_plies = 8; // ... in every search for this many plies in a row: that side wins
+	int draw_score = 10; // every search is within this of 0 ...
+	unsigned int draw_plies = 12; // ... for this many plies in a row ...
+	unsigned int draw_after = 80; // ... after this many plies of the game: a draw
+};
+
+struct SelfplayStats {
+	uint64_t games = 0;
+	uint64_t white_wins = 0;
+	uint64_t draws = 0;
+	uint64_t black_wins = 0;
+	uint64_t positions = 0;
+};
+
+// Plays one game and returns the position before every searched move, labelled with the search score from the side to
+// move's point of view and with the game's result in the state bits. The positions of the opening are not included.
+// book may be nullptr.
+std::vector<PackedPosition> play_selfplay_game(const SelfplayOptions& options, unsigned int game, PolyglotBook* book);
+
+// selfplay <out.bin> [games <n>] [threads <n>] [depth <n>] [nodes <n>] [hash <mb>] [book <file.bin>] [random <plies>]
+//          [seed <n>] [tablebases <dir>]
+// Plays games of the engine against itself, several at once, and appends their positions to out.bin as PackedPosition records.
+int selfplay_main(int argc, char* argv[]);
@@ -0,0 +1,78 @@
+#include "Stats.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+
+// Blocks are never freed, so a thread's counts survive it and a snapshot never reads freed memory.
+std::mutex stats_mutex;
+std::vector<std::unique_ptr<ThreadStats>> stats_blocks;
+
+ThreadStats& thread_stats() {
+	thread_local ThreadStats* block = nullptr;
+	if (!block) {
+		std::lock_guard<std::mutex> lock(stats_mutex);
+		stats_blocks.emplace_back(new ThreadStats());
+		block = stats_blocks.back().get();
+	}
+	return *block;
+}
+
+StatsSnapshot stats_snapshot() {
+	StatsSnapshot total = {};
+	std::lock_guard<std::mutex> lock(stats_mutex);
+	for (auto& block : stats_blocks) {
+		for (int i = 0; i < STAT_COUNT; ++i) {
+			total[i] += block->counters[i].load(std::memory_order_relaxed);
+		}
+	}
+	return total;
+}
+
+// Only exact when no other thread is counting at the same time
+void stats_reset() {
+	std::lock_guard<std::mutex> lock(stats_mutex);
+	for (auto& block : stats_blocks) {
+		for (auto& counter : block->counters) {
+			counter.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+const char* stat_name(StatCounters counter) {
+	static const char* names[STAT_COUNT] = {
+		"nodes", "qnodes",
+		"make_move_std", "make_move_castle", "make_move_promotion", "make_move_en_passant",
+		"king_threats", "move_gen_calls", "moves_generated", "moves_searched",
+		"tt_probes", "tt_hits", "tt_cutoffs",
+		"beta_cutoffs", "cutoff_move_1", "cutoff_move_2", "cutoff_move_3", "cutoff_move_4_7", "cutoff_move_8_15", "cutoff_move_16_plus"
+	};
+	return names[counter];
+}
+
+// move_index counts from 0 for the first move searched
+StatCounters cutoff_bin(unsigned int move_index) {
+	if (move_index < 3) { return static_cast<StatCounters>(STAT_CUTOFF_MOVE_1 + move_index); }
+	if (move_index < 7) { return STAT_CUTOFF_MOVE_4_7; }
+	if (move_index < 15) { return STAT_CUTOFF_MOVE_8_15; }
+	return STAT_CUTOFF_MOVE_16_PLUS;
+}
+
+std::string stats_json(const StatsSnapshot& snapshot) {
+	auto ratio = [](uint64_t amount, uint64_t count) { return count ? double(amount) / double(count) : 0.0; };
+	uint64_t all_nodes = snapshot[STAT_NODES] + snapshot[STAT_QNODES];
+
+	std::ostringstream json;
+	json << "{";
+	for (int i = 0; i < STAT_COUNT; ++i) {
+		json << (i ? ", " : "") << "\"" << stat_name(static_cast<StatCounters>(i)) << "\": " << snapshot[i];
+	}
+	json << std::fixed << std::setprecision(3)
+		<< ", \"generated_per_call\": " << ratio(snapshot[STAT_MOVES_GENERATED], snapshot[STAT_MOVE_GEN_CALLS])
+		<< ", \"searched_per_node\": " << ratio(snapshot[STAT_MOVES_SEARCHED], all_nodes)
+		<< ", \"tt_hit_rate\": " << ratio(snapshot[STAT_TT_HITS], snapshot[STAT_TT_PROBES])
+		<< ", \"first_move_cutoff_rate\": " << ratio(snapshot[STAT_CUTOFF_MOVE_1], snapshot[STAT_BETA_CUTOFFS])
+		<< "}";
+	return json.str();
+}
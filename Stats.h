@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <atomic>
+#include "stdint.h"
+
+// Hot path counters, compiled in only when ENABLE_STATS is defined. Without it every STAT_ macro expands to nothing,
+// so the counting costs nothing at all in a normal build.
+//
+// Each thread counts into its own cache line sized block, so counting never contends with other threads. The blocks
+// are summed when a snapshot is taken.
+enum StatCounters {
+	STAT_NODES, // negamax nodes
+	STAT_QNODES, // quiescence nodes
+	STAT_MAKE_MOVE_STD, // make_move calls, one counter per SpecialMoves type, in the same order
+	STAT_MAKE_MOVE_CASTLE,
+	STAT_MAKE_MOVE_PROMOTION,
+	STAT_MAKE_MOVE_EN_PASSANT,
+	STAT_KING_THREATS,
+	STAT_MOVE_GEN_CALLS,
+	STAT_MOVES_GENERATED, // the generator only produces legal moves, so this is also the legal move count
+	STAT_MOVES_SEARCHED, // moves the search actually played, after pruning
+	STAT_TT_PROBES,
+	STAT_TT_HITS,
+	STAT_TT_CUTOFFS,
+	STAT_BETA_CUTOFFS,
+	STAT_CUTOFF_MOVE_1, // beta cutoffs by the index of the move that caused them, in bins
+	STAT_CUTOFF_MOVE_2,
+	STAT_CUTOFF_MOVE_3,
+	STAT_CUTOFF_MOVE_4_7,
+	STAT_CUTOFF_MOVE_8_15,
+	STAT_CUTOFF_MOVE_16_PLUS,
+	STAT_COUNT
+};
+
+struct alignas(64) ThreadStats {
+	std::array<std::atomic<uint64_t>, STAT_COUNT> counters; // only ever written by the owning thread, relaxed loads and stores
+
+	ThreadStats() { for (auto& counter : counters) { counter.store(0, std::memory_order_relaxed); } }
+	void add(StatCounters counter, uint64_t amount) {
+		counters[counter].store(counters[counter].load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+};
+
+typedef std::array<uint64_t, STAT_COUNT> StatsSnapshot;
+
+ThreadStats& thread_stats(); // this thread's block, registered on first use
+StatsSnapshot stats_snapshot(); // the sum over every thread that has counted anything
+void stats_reset();
+const char* stat_name(StatCounters counter);
+StatCounters cutoff_bin(unsigned int move_index);
+std::string stats_json(const StatsSnapshot& snapshot); // one line, with per-node ratios at the end
+
+#ifdef ENABLE_STATS
+const bool STATS_ENABLED = true;
+#define STAT_ADD(counter, amount) thread_stats().add((counter), (amount))
+#else
+const bool STATS_ENABLED = false;
+#define STAT_ADD(counter, amount) ((void)0)
+#endif
+#define STAT_INC(counter) STAT_ADD(counter, 1)
@@ -0,0 +1,795 @@
+#include "Tablebase.h"
+#include "Attacks.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <cstring>
+
+const char TB_PIECE_LETTERS[] = "PNBRQK";
+const uint8_t TB_DRAW_VALUE = 0; // while generating, also every position not decided yet
+const uint8_t TB_ILLEGAL_VALUE = 255;
+const int TB_MAX_PLIES = 252; // the longest loss a byte can hold
+const unsigned int TB_MAX_MOVES = 128; // more than any position of up to four pieces has, promotions counted four times
+const size_t TB_CHUNK = 1 << 16; // indices per parallel job
+const size_t TB_FRONTIER_CHUNK = 1 << 12; // decided positions per parallel job when looking for their predecessors
+const uint8_t NO_KING_CODE = 255;
+
+struct TbFileHeader {
+	char magic[4]; // "CTBD" in .dtm files, "CTBW" in .wdl files
+	uint32_t version;
+	uint64_t entries;
+};
+
+static_assert(sizeof(TbFileHeader) == 16, "the table payload starts 16 bytes into the file");
+
+const uint32_t TB_FILE_VERSION = 1;
+
+// The eight symmetries of the board as square maps: bit 0 mirrors left to right, bit 1 top to bottom, bit 2 swaps rows and
+// files. With pawns on the board only the first two keep a position the same position.
+struct TbSymmetries {
+	std::array<std::array<uint8_t, 64>, 8> squares;
+	std::array<std::array<uint8_t, 64>, 2> king_code; // [pawns][square]: the white king's part of the index, NO_KING_CODE where it is never kept
+	std::array<std::array<uint8_t, 32>, 2> code_square; // [pawns][code]: and back
+
+	TbSymmetries();
+};
+
+TbSymmetries::TbSymmetries() {
+	for (unsigned int sym = 0; sym < 8; ++sym) {
+		for (unsigned int sq = 0; sq < 64; ++sq) {
+			unsigned int row = sq / 8, file = sq % 8;
+			if (sym & 4) { std::swap(row, file); }
+			if (sym & 1) { file = 7 - file; }
+			if (sym & 2) { row = 7 - row; }
+			squares[sym][sq] = static_cast<uint8_t>(row * 8 + file);
+		}
+	}
+
+	for (auto& codes : king_code) { codes.fill(NO_KING_CODE); }
+	uint8_t triangle = 0, half = 0;
+	for (unsigned int sq = 0; sq < 64; ++sq) {
+		unsigned int row = sq / 8, file = sq % 8;
+		if (file < 4 && row <= file) {
+			king_code[0][sq] = triangle;
+			code_square[0][triangle++] = static_cast<uint8_t>(sq);
+		}
+		if (file < 4) {
+			king_code[1][sq] = half;
+			code_square[1][half++] = static_cast<uint8_t>(sq);
+		}
+	}
+}
+
+const TbSymmetries tb_symmetries;
+
+uint64_t square_bit(unsigned int sq) {
+	return uint64_t(1) << sq;
+}
+
+uint8_t win_value(int plies) {
+	return static_cast<uint8_t>((plies + 1) / 2);
+}
+
+uint8_t loss_value(int plies) {
+	return static_cast<uint8_t>(128 + plies / 2);
+}
+
+bool value_result(uint8_t value, TbResult& result) {
+	if (value == TB_ILLEGAL_VALUE) { return false; }
+	if (value == TB_DRAW_VALUE) { result = { 0, -1 }; }
+	else if (value < 128) { result = { 1, 2 * value - 1 }; }
+	else { result = { -1, 2 * (value - 128) }; }
+	return true;
+}
+
+std::string tablebase_path(const std::string& directory, const std::string& name, const char* extension) {
+	return directory.empty() ? name + extension : directory + "/" + name + extension;
+}
+
+// Whether a piece of color `by` attacks sq. skip is the index of a piece to leave out because it has just been captured, or
+// the piece count for none.
+bool tb_attacked(const std::vector<TbPiece>& pieces, const TbBoard& board, unsigned int sq, Colors by, uint64_t occupied, size_t skip) {
+	for (size_t i = 0; i < pieces.size(); ++i) {
+		if (i != skip && pieces[i].color == by && (piece_attacks(by, pieces[i].type, board.squares[i], occupied) & square_bit(sq))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string tablebase_class(const TbPosition& pos, bool& flipped) {
+	std::array<std::array<int, TB_MAX_PIECES>, 2> sides;
+	std::array<size_t, 2> counts = { 0, 0 };
+	for (unsigned int i = 0; i < pos.count; ++i) {
+		if (pos.pieces[i].type != KING) { sides[pos.pieces[i].color][counts[pos.pieces[i].color]++] = pos.pieces[i].type; }
+	}
+	for (int color = 0; color < 2; ++color) {
+		std::sort(sides[color].begin(), sides[color].begin() + counts[color], std::greater<int>());
+	}
+
+	// the side with the stronger pieces is white in the name
+	flipped = std::lexicographical_compare(sides[WHITE].begin(), sides[WHITE].begin() + counts[WHITE], sides[BLACK].begin(), sides[BLACK].begin() + counts[BLACK]);
+	std::string name;
+	for (Colors color : { flipped ? BLACK : WHITE, flipped ? WHITE : BLACK }) {
+		name += 'K';
+		for (size_t i = 0; i < counts[color]; ++i) { name += TB_PIECE_LETTERS[sides[color][i]]; }
+	}
+	return name;
+}
+
+std::vector<std::string> tablebase_classes() {
+	std::vector<std::string> classes;
+	TbPosition pos;
+	pos.pieces[0] = { WHITE, KING };
+	pos.pieces[1] = { BLACK, KING };
+	bool flipped;
+	for (int first = PAWN; first <= QUEEN; ++first) {
+		pos.count = 3;
+		pos.pieces[2] = { WHITE, static_cast<Types>(first) };
+		classes.push_back(tablebase_class(pos, flipped));
+		for (int second = PAWN; second <= QUEEN; ++second) {
+			pos.count = 4;
+			for (Colors color : { WHITE, BLACK }) {
+				pos.pieces[3] = { color, static_cast<Types>(second) };
+				classes.push_back(tablebase_class(pos, flipped));
+			}
+		}
+	}
+
+	// fewest pieces first, so that a class comes after every class it converts into
+	std::sort(classes.begin(), classes.end(), [](const std::string& a, const std::string& b) {
+		return a.size() != b.size() ? a.size() < b.size() : a < b;
+	});
+	classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+	return classes;
+}
+
+bool Tablebase::set_material(const std::string& material) {
+	size_t second = material.find('K', 1);
+	if (material.size() > TB_MAX_PIECES || material.empty() || material[0] != 'K' || second == std::string::npos) {
+		return false;
+	}
+
+	std::vector<TbPiece> list = { { WHITE, KING }, { BLACK, KING } };
+	for (size_t i = 1; i < material.size(); ++i) {
+		if (i == second) { continue; }
+		const char* letter = std::find(TB_PIECE_LETTERS, TB_PIECE_LETTERS + 5, material[i]); // no third king
+		if (letter == TB_PIECE_LETTERS + 5) { return false; }
+		list.push_back({ i < second ? WHITE : BLACK, static_cast<Types>(letter - TB_PIECE_LETTERS) });
+	}
+	std::stable_sort(list.begin() + 2, list.end(), [](const TbPiece& a, const TbPiece& b) {
+		return a.color != b.color ? a.color < b.color : a.type > b.type;
+	});
+
+	pieces = list;
+	pawns = std::any_of(pieces.begin(), pieces.end(), [](const TbPiece& piece) { return piece.type == PAWN; });
+	name = "K";
+	for (Colors color : { WHITE, BLACK }) {
+		if (color == BLACK) { name += 'K'; }
+		for (size_t i = 2; i < pieces.size(); ++i) {
+			if (pieces[i].color == color) { name += TB_PIECE_LETTERS[pieces[i].type]; }
+		}
+	}
+
+	half_size = pawns ? 32 : 10;
+	for (size_t i = 1; i < pieces.size(); ++i) { half_size *= 64; }
+	generated.clear();
+	file.close();
+	data = nullptr;
+	dtm = true;
+	return true;
+}
+
+size_t Tablebase::index(const TbBoard& board) const {
+	size_t count = pieces.size(), best = SIZE_MAX;
+	for (unsigned int sym = 0; sym < (pawns ? 2u : 8u); ++sym) {
+		const std::array<uint8_t, 64>& map = tb_symmetries.squares[sym];
+		uint8_t code = tb_symmetries.king_code[pawns][map[board.squares[0]]];
+		if (code == NO_KING_CODE) { continue; }
+
+		std::array<uint8_t, TB_MAX_PIECES> squares;
+		for (size_t i = 0; i < count; ++i) { squares[i] = map[board.squares[i]]; }
+		for (size_t i = 2; i + 1 < count; ++i) { // two of the same piece can trade squares, keep them in ascending order
+			if (pieces[i].color == pieces[i + 1].color && pieces[i].type == pieces[i + 1].type && squares[i] > squares[i + 1]) {
+				std::swap(squares[i], squares[i + 1]);
+			}
+		}
+
+		size_t key = code;
+		for (size_t i = 1; i < count; ++i) { key = key * 64 + squares[i]; }
+		best = std::min(best, key);
+	}
+	return board.turn * half_size + best;
+}
+
+void Tablebase::unpack(size_t index, TbBoard& board) const {
+	board.turn = index < half_size ? WHITE : BLACK;
+	size_t rest = index % half_size;
+	for (size_t i = pieces.size() - 1; i >= 1; --i) {
+		board.squares[i] = static_cast<uint8_t>(rest % 64);
+		rest /= 64;
+	}
+	board.squares[0] = tb_symmetries.code_square[pawns][rest];
+}
+
+bool Tablebase::decode(size_t index, TbBoard& board) const {
+	unpack(index, board);
+	uint64_t occupied = 0;
+	for (size_t i = 0; i < pieces.size(); ++i) {
+		uint64_t bit = square_bit(board.squares[i]);
+		if (occupied & bit) { return false; }
+		if (pieces[i].type == PAWN && (board.squares[i] / 8 == 0 || board.squares[i] / 8 == 7)) { return false; }
+		occupied |= bit;
+	}
+	if (attack_tables.king[board.squares[0]] & square_bit(board.squares[1])) {
+		return false;
+	}
+	if (this->index(board) != index) {
+		return false;
+	}
+	Colors waiting = !board.turn; // the side that just moved cannot be left in check
+	return !tb_attacked(pieces, board, board.squares[waiting == WHITE ? 0 : 1], board.turn, occupied, pieces.size());
+}
+
+bool Tablebase::probe(size_t index, TbResult& result) const {
+	if (dtm) {
+		return value_result(data[index], result);
+	}
+	switch ((data[index / 4] >> (2 * (index % 4))) & 3) {
+	case 0: result = { 0, -1 }; return true;
+	case 1: result = { 1, -1 }; return true;
+	case 2: result = { -1, -1 }; return true;
+	default: return false;
+	}
+}
+
+// The result of every legal move from the board, for the side that is to move after it. Moves that stay in the class are
+// looked up in what has been generated so far, captures and promotions in the other tables.
+unsigned int Tablebase::children(const TbBoard& board, const Tablebases& others, TbResult* results) const {
+	size_t count = pieces.size();
+	Colors us = board.turn, them = !us;
+	uint64_t occupied = 0, ours = 0, theirs = 0;
+	for (size_t i = 0; i < count; ++i) {
+		occupied |= square_bit(board.squares[i]);
+		(pieces[i].color == us ? ours : theirs) |= square_bit(board.squares[i]);
+	}
+
+	unsigned int moves = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (pieces[i].color != us) { continue; }
+		unsigned int from = board.squares[i];
+		Types type = pieces[i].type;
+		uint64_t targets;
+		if (type == PAWN) {
+			int step = (us == WHITE) ? -8 : 8;
+			unsigned int one = from + step;
+			targets = attack_tables.pawn[us][from] & theirs;
+			if (!(occupied & square_bit(one))) {
+				targets |= square_bit(one);
+				if (from / 8 == (us == WHITE ? 6u : 1u) && !(occupied & square_bit(one + step))) { targets |= square_bit(one + step); }
+			}
+		}
+		else {
+			targets = piece_attacks(us, type, from, occupied) & ~ours;
+		}
+
+		for (; targets; targets &= targets - 1) {
+			unsigned int to = lowest_square(targets);
+			size_t captured = count;
+			if (theirs & square_bit(to)) {
+				for (size_t j = 0; j < count; ++j) {
+					if (board.squares[j] == to) { captured = j; }
+				}
+			}
+
+			TbBoard child = board;
+			child.squares[i] = static_cast<uint8_t>(to);
+			child.turn = them;
+			uint64_t after = (occupied & ~square_bit(from)) | square_bit(to);
+			if (tb_attacked(pieces, child, child.squares[us == WHITE ? 0 : 1], them, after, captured)) {
+				continue;
+			}
+
+			bool promotes = type == PAWN && (to / 8 == 0 || to / 8 == 7);
+			if (captured == count && !promotes) {
+				value_result(generated[index(child)], results[moves++]);
+				continue;
+			}
+
+			// a capture or a promotion leaves the class
+			TbPosition next;
+			next.count = 0;
+			next.turn = them;
+			unsigned int mover = 0;
+			for (size_t j = 0; j < count; ++j) {
+				if (j == captured) { continue; }
+				if (j == i) { mover = next.count; }
+				next.pieces[next.count] = pieces[j];
+				next.squares[next.count++] = child.squares[j];
+			}
+			for (int promoted = (promotes ? QUEEN : type); promoted >= (promotes ? KNIGHT : type); --promoted) {
+				next.pieces[mover].type = static_cast<Types>(promoted);
+				if (!others.probe(next, results[moves])) { results[moves] = { 0, -1 }; } // generate checks first that the tables are there
+				++moves;
+			}
+		}
+	}
+	return moves;
+}
+
+// Undecided positions one move before the board, with the other side to move. Only moves that stay in the class are taken
+// back: positions before a capture or a promotion belong to a bigger class.
+void Tablebase::predecessors(const TbBoard& board, std::vector<uint32_t>& found) const {
+	Colors mover = !board.turn;
+	uint64_t occupied = 0;
+	for (size_t i = 0; i < pieces.size(); ++i) { occupied |= square_bit(board.squares[i]); }
+
+	for (size_t i = 0; i < pieces.size(); ++i) {
+		if (pieces[i].color != mover) { continue; }
+		unsigned int to = board.squares[i], row = to / 8;
+		uint64_t origins = 0;
+		if (pieces[i].type == PAWN) {
+			int step = (mover == WHITE) ? 8 : -8; // back the way the pawn came
+			unsigned int one = to + step;
+			if ((mover == WHITE ? row <= 5 : row >= 2) && !(occupied & square_bit(one))) {
+				origins |= square_bit(one);
+				if (row == (mover == WHITE ? 4u : 3u) && !(occupied & square_bit(one + step))) { origins |= square_bit(one + step); }
+			}
+		}
+		else {
+			origins = piece_attacks(mover, pieces[i].type, to, occupied) & ~occupied;
+		}
+
+		for (; origins; origins &= origins - 1) {
+			TbBoard before = board;
+			before.squares[i] = static_cast<uint8_t>(lowest_square(origins));
+			before.turn = mover;
+			size_t before_index = index(before);
+			if (generated[before_index] == TB_DRAW_VALUE) { found.push_back(static_cast<uint32_t>(before_index)); }
+		}
+	}
+}
+
+std::vector<std::string> Tablebase::child_classes() const {
+	std::vector<std::string> classes;
+	TbPosition pos;
+	pos.count = static_cast<unsigned int>(pieces.size());
+	pos.turn = WHITE;
+	std::copy(pieces.begin(), pieces.end(), pos.pieces.begin());
+	bool flipped;
+
+	auto add_without = [&](const TbPosition& from, size_t removed) {
+		TbPosition next = from;
+		next.count = 0;
+		for (size_t j = 0; j < from.count; ++j) {
+			if (j != removed) { next.pieces[next.count++] = from.pieces[j]; }
+		}
+		classes.push_back(tablebase_class(next, flipped));
+	};
+
+	for (size_t i = 2; i < pieces.size(); ++i) {
+		add_without(pos, i);
+		if (pieces[i].type != PAWN) { continue; }
+		for (int promoted = KNIGHT; promoted <= QUEEN; ++promoted) {
+			TbPosition next = pos;
+			next.pieces[i].type = static_cast<Types>(promoted);
+			classes.push_back(tablebase_class(next, flipped));
+			for (size_t j = 2; j < pieces.size(); ++j) {
+				if (pieces[j].color != pieces[i].color) { add_without(next, j); } // promoting with a capture
+			}
+		}
+	}
+
+	std::sort(classes.begin(), classes.end());
+	classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+	return classes;
+}
+
+// Retrograde analysis, one ply of distance to mate at a time. The mates are found first. Then a position is won in n plies
+// if a move leads to a loss in n - 1, and lost in n if every move leads to a win in fewer, and the only positions worth
+// trying at each step are those one move before a position decided at the last step, or those with a capture or promotion
+// whose result decides them at this step. Whatever is never decided is a draw.
+bool Tablebase::generate(const Tablebases& others, unsigned int threads) {
+	for (const std::string& child : child_classes()) {
+		if (child != "KK" && !others.find(child)) { return false; }
+	}
+	generated.assign(size(), TB_DRAW_VALUE);
+	data = nullptr;
+	dtm = true;
+	size_t chunks = (size() + TB_CHUNK - 1) / TB_CHUNK;
+
+	parallel_for(chunks, threads, [&](size_t chunk) {
+		TbBoard board;
+		size_t last = std::min(size(), (chunk + 1) * TB_CHUNK);
+		for (size_t i = chunk * TB_CHUNK; i < last; ++i) {
+			if (!decode(i, board)) { generated[i] = TB_ILLEGAL_VALUE; }
+		}
+	});
+
+	// mates, and the steps at which a capture or promotion may decide a position. Nothing in the class is decided yet, so
+	// every decided result here comes from another table
+	std::vector<std::vector<uint32_t>> mates(chunks);
+	std::vector<std::vector<std::pair<int, uint32_t>>> exits(chunks);
+	parallel_for(chunks, threads, [&](size_t chunk) {
+		std::array<TbResult, TB_MAX_MOVES> results;
+		TbBoard board;
+		size_t last = std::min(size(), (chunk + 1) * TB_CHUNK);
+		for (size_t i = chunk * TB_CHUNK; i < last; ++i) {
+			if (generated[i] == TB_ILLEGAL_VALUE) { continue; }
+			unpack(i, board);
+			unsigned int moves = children(board, others, results.data());
+			if (moves == 0) {
+				uint64_t occupied = 0;
+				for (size_t j = 0; j < pieces.size(); ++j) { occupied |= square_bit(board.squares[j]); }
+				if (tb_attacked(pieces, board, board.squares[board.turn == WHITE ? 0 : 1], !board.turn, occupied, pieces.size())) {
+					mates[chunk].push_back(static_cast<uint32_t>(i));
+				}
+				continue; // stalemate otherwise
+			}
+			for (unsigned int m = 0; m < moves; ++m) {
+				if (results[m].wdl != 0 && results[m].plies < TB_MAX_PLIES) { exits[chunk].emplace_back(results[m].plies + 1, static_cast<uint32_t>(i)); }
+			}
+		}
+	});
+
+	std::vector<std::vector<uint32_t>> exits_by_step;
+	for (const auto& list : exits) {
+		for (const auto& exit : list) {
+			if (exit.first >= int(exits_by_step.size())) { exits_by_step.resize(exit.first + 1); }
+			exits_by_step[exit.first].push_back(exit.second);
+		}
+	}
+	exits.clear();
+
+	std::vector<uint32_t> frontier;
+	for (const auto& list : mates) {
+		for (uint32_t i : list) {
+			generated[i] = loss_value(0);
+			frontier.push_back(i);
+		}
+	}
+	mates.clear();
+
+	for (int step = 1; step <= TB_MAX_PLIES && (!frontier.empty() || step < int(exits_by_step.size())); ++step) {
+		std::vector<uint32_t> candidates;
+		if (step < int(exits_by_step.size())) { candidates.swap(exits_by_step[step]); }
+
+		size_t jobs = (frontier.size() + TB_FRONTIER_CHUNK - 1) / TB_FRONTIER_CHUNK;
+		std::vector<std::vector<uint32_t>> found(jobs);
+		parallel_for(jobs, threads, [&](size_t job) {
+			TbBoard board;
+			size_t last = std::min(frontier.size(), (job + 1) * TB_FRONTIER_CHUNK);
+			for (size_t i = job * TB_FRONTIER_CHUNK; i < last; ++i) {
+				unpack(frontier[i], board);
+				predecessors(board, found[job]);
+			}
+		});
+		for (const auto& list : found) { candidates.insert(candidates.end(), list.begin(), list.end()); }
+		found.clear();
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+		// wins can only be decided at odd steps and losses at even ones. Nothing is written until every candidate has been
+		// tried, so that a position decided at this step is not taken as one decided before it
+		bool winning = step % 2 == 1;
+		jobs = (candidates.size() + TB_FRONTIER_CHUNK - 1) / TB_FRONTIER_CHUNK;
+		std::vector<std::vector<uint32_t>> decided(jobs);
+		parallel_for(jobs, threads, [&](size_t job) {
+			std::array<TbResult, TB_MAX_MOVES> results;
+			TbBoard board;
+			size_t last = std::min(candidates.size(), (job + 1) * TB_FRONTIER_CHUNK);
+			for (size_t i = job * TB_FRONTIER_CHUNK; i < last; ++i) {
+				if (generated[candidates[i]] != TB_DRAW_VALUE) { continue; }
+				unpack(candidates[i], board);
+				unsigned int moves = children(board, others, results.data());
+				bool won = false, lost = moves > 0;
+				for (unsigned int m = 0; m < moves; ++m) {
+					won |= results[m].wdl < 0 && results[m].plies == step - 1;
+					lost &= results[m].wdl > 0 && results[m].plies < step;
+				}
+				if (winning ? won : lost) { decided[job].push_back(candidates[i]); }
+			}
+		});
+
+		frontier.clear();
+		for (const auto& list : decided) {
+			for (uint32_t i : list) {
+				generated[i] = winning ? win_value(step) : loss_value(step);
+				frontier.push_back(i);
+			}
+		}
+	}
+
+	data = generated.data();
+	return true;
+}
+
+bool Tablebase::write(const std::string& directory) const {
+	TbFileHeader header = { { 'C', 'T', 'B', 'D' }, TB_FILE_VERSION, size() };
+	std::ofstream dtm_file(tablebase_path(directory, name, ".dtm"), std::ios::binary);
+	dtm_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	dtm_file.write(reinterpret_cast<const char*>(data), size());
+
+	std::vector<uint8_t> fields((size() + 3) / 4, 0);
+	for (size_t i = 0; i < size(); ++i) {
+		TbResult result;
+		uint8_t field = !probe(i, result) ? 3 : result.wdl > 0 ? 1 : result.wdl < 0 ? 2 : 0;
+		fields[i / 4] |= field << (2 * (i % 4));
+	}
+	header.magic[3] = 'W';
+	std::ofstream wdl_file(tablebase_path(directory, name, ".wdl"), std::ios::binary);
+	wdl_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	wdl_file.write(reinterpret_cast<const char*>(fields.data()), fields.size());
+	return dtm_file.good() && wdl_file.good();
+}
+
+bool Tablebase::load(const std::string& directory) {
+	generated.clear();
+	data = nullptr;
+	for (bool distances : { true, false }) {
+		size_t payload = distances ? size() : (size() + 3) / 4;
+		if (!file.open(tablebase_path(directory, name, distances ? ".dtm" : ".wdl"))) {
+			continue;
+		}
+		TbFileHeader header;
+		if (file.size() == sizeof(header) + payload) {
+			std::memcpy(&header, file.data(), sizeof(header));
+			if (std::memcmp(header.magic, distances ? "CTBD" : "CTBW", 4) == 0 && header.version == TB_FILE_VERSION && header.entries == size()) {
+				data = reinterpret_cast<const uint8_t*>(file.data()) + sizeof(header);
+				dtm = distances;
+				return true;
+			}
+		}
+		file.close();
+	}
+	return false;
+}
+
+void Tablebases::add(std::unique_ptr<Tablebase> table) {
+	max_pieces = std::max(max_pieces, static_cast<unsigned int>(table->get_pieces().size()));
+	std::string name = table->get_name();
+	tables[name] = std::move(table);
+}
+
+const Tablebase* Tablebases::find(const std::string& name) const {
+	auto found = tables.find(name);
+	return found == tables.end() ? nullptr : found->second.get();
+}
+
+bool Tablebases::probe(const TbPosition& pos, TbResult& result) const {
+	if (pos.count == 2) {
+		result = { 0, -1 };
+		return true;
+	}
+	bool flipped;
+	const Tablebase* table = find(tablebase_class(pos, flipped));
+	if (!table) {
+		return false;
+	}
+
+	// put the pieces in the table's order, swapping the colors and mirroring top to bottom when the class is the other way round
+	const std::vector<TbPiece>& order = table->get_pieces();
+	TbBoard board;
+	board.turn = flipped ? !pos.turn : pos.turn;
+	unsigned int used = 0;
+	for (size_t slot = 0; slot < order.size(); ++slot) {
+		for (unsigned int i = 0; i < pos.count; ++i) {
+			Colors color = flipped ? !pos.pieces[i].color : pos.pieces[i].color;
+			if (!(used & (1u << i)) && color == order[slot].color && pos.pieces[i].type == order[slot].type) {
+				used |= 1u << i;
+				board.squares[slot] = static_cast<uint8_t>(flipped ? pos.squares[i] ^ 56 : pos.squares[i]);
+				break;
+			}
+		}
+	}
+	return table->probe(table->index(board), result);
+}
+
+// The pieces of the position, false if there are too many for any table
+bool tablebase_position(Position& pos, TbPosition& tb) {
+	tb.count = 0;
+	tb.turn = pos.get_turn();
+	for (int color = 0; color < 2; ++color) {
+		for (int type = 0; type < 6; ++type) {
+			for (uint64_t pieces = pos.get_pieces(static_cast<Colors>(color), static_cast<Types>(type)).get_u64(); pieces; pieces &= pieces - 1) {
+				if (tb.count == TB_MAX_PIECES) { return false; }
+				tb.pieces[tb.count] = { static_cast<Colors>(color), static_cast<Types>(type) };
+				tb.squares[tb.count++] = lowest_square(pieces);
+			}
+		}
+	}
+	return true;
+}
+
+std::unique_ptr<Tablebases> loaded_tablebases;
+
+unsigned int load_tablebases(const std::string& directory) {
+	std::unique_ptr<Tablebases> set(new Tablebases());
+	for (const std::string& name : tablebase_classes()) {
+		std::unique_ptr<Tablebase> table(new Tablebase());
+		if (table->set_material(name) && table->load(directory)) { set->add(std::move(table)); }
+	}
+	unsigned int count = static_cast<unsigned int>(set->size());
+	loaded_tablebases = count > 0 ? std::move(set) : nullptr;
+	return count;
+}
+
+unsigned int tablebase_pieces() {
+	return loaded_tablebases ? loaded_tablebases->get_max_pieces() : 0;
+}
+
+bool probe_tablebase(Position& pos, TbResult& result) {
+	if (!loaded_tablebases || pos.get_castling()) {
+		return false;
+	}
+	Square ep = pos.get_ep_square();
+	if (!ep.is_empty() && (attack_tables.pawn[!pos.get_turn()][ep.convert_to_index()] & pos.get_pieces(pos.get_turn(), PAWN).get_u64())) {
+		return false; // the tables know nothing of en passant
+	}
+	TbPosition tb;
+	return tablebase_position(pos, tb) && loaded_tablebases->probe(tb, result);
+}
+
+std::string board_fen(const Tablebase& table, const TbBoard& board) {
+	std::array<char, 64> squares;
+	squares.fill(0);
+	for (size_t i = 0; i < table.get_pieces().size(); ++i) {
+		const TbPiece& piece = table.get_pieces()[i];
+		char letter = TB_PIECE_LETTERS[piece.type];
+		squares[board.squares[i]] = piece.color == WHITE ? letter : static_cast<char>(letter | 0x20);
+	}
+	std::string fen;
+	for (unsigned int row = 0; row < 8; ++row) {
+		int empty = 0;
+		for (unsigned int file = 0; file < 8; ++file) {
+			char c = squares[row * 8 + file];
+			if (!c) { ++empty; continue; }
+			if (empty) { fen += static_cast<char>('0' + empty); empty = 0; }
+			fen += c;
+		}
+		if (empty) { fen += static_cast<char>('0' + empty); }
+		fen += row < 7 ? '/' : ' ';
+	}
+	return fen + (board.turn == WHITE ? "w - - 0 1" : "b - - 0 1");
+}
+
+// Sets up random positions of the class as Position objects, plays every legal move with make_move and checks that the
+// table holds the best of the results those moves lead to. Returns the number of positions that do not agree.
+size_t verify_tablebase(const Tablebase& table, const Tablebases& set, size_t samples) {
+	std::mt19937_64 random(table.size());
+	std::uniform_int_distribution<size_t> pick(0, table.size() - 1);
+	size_t checked = 0, wrong = 0;
+	for (size_t attempt = 0; checked < samples && attempt < 100 * samples; ++attempt) {
+		TbBoard board;
+		TbResult expected;
+		size_t i = pick(random);
+		if (!table.decode(i, board) || !table.probe(i, expected)) { continue; }
+		++checked;
+
+		std::string fen = board_fen(table, board);
+		Position pos;
+		pos.parse_fen(fen);
+		std::vector<Move> moves = pos.move_gen();
+		TbResult best = { -1, 0 };
+		if (moves.empty()) {
+			best = pos.is_in_check() ? TbResult{ -1, 0 } : TbResult{ 0, -1 };
+		}
+		for (const Move& move : moves) {
+			TbPosition child;
+			TbResult result = { 0, -1 };
+			pos.make_move(move);
+			bool found = tablebase_position(pos, child) && set.probe(child, result);
+			pos.undo();
+			if (!found) { result = { 0, -1 }; }
+
+			// the child's result is the opponent's: theirs lost in n is ours won in n + 1
+			TbResult ours = { -result.wdl, result.wdl != 0 ? result.plies + 1 : -1 };
+			bool better = ours.wdl > best.wdl
+				|| (ours.wdl == best.wdl && ours.wdl > 0 && ours.plies < best.plies)
+				|| (ours.wdl == best.wdl && ours.wdl < 0 && ours.plies > best.plies);
+			if (better) { best = ours; }
+		}
+		if (best.wdl != expected.wdl || best.plies != expected.plies) {
+			if (wrong++ < 5) {
+				std::cerr << table.get_name() << ": " << fen << " is " << expected.wdl << " in " << expected.plies << " plies in the table, its moves say "
+					<< best.wdl << " in " << best.plies << std::endl;
+			}
+		}
+	}
+	return wrong;
+}
+
+int tbgen_main(int argc, char* argv[]) {
+	const char* usage = "usage: tb-gen <directory> [threads <n>] [verify <samples>] [<class> ...]";
+	if (argc < 2) {
+		std::cerr << usage << std::endl;
+		return 2;
+	}
+	std::string directory = argv[1];
+	unsigned int threads = default_thread_count();
+	size_t samples = 0;
+	std::vector<std::string> wanted;
+	for (int i = 2; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool valid = true;
+		if (arg == "threads" && i + 1 < argc) { valid = parse_number(argv[++i], threads); }
+		else if (arg == "verify" && i + 1 < argc) { valid = parse_number(argv[++i], samples); }
+		else { wanted.push_back(arg); }
+		if (!valid) {
+			std::cerr << usage << std::endl;
+			return 2;
+		}
+	}
+	threads = std::max(1u, threads);
+	if (wanted.empty()) {
+		wanted = tablebase_classes();
+	}
+
+	Tablebases set;
+	size_t failures = 0;
+	std::function<bool(const std::string&)> build = [&](const std::string& material) {
+		std::unique_ptr<Tablebase> table(new Tablebase());
+		if (!table->set_material(material)) {
+			std::cerr << material << " is not a class of at most " << TB_MAX_PIECES << " pieces" << std::endl;
+			return false;
+		}
+
+		// files hold the stronger side as white
+		TbPosition pos;
+		pos.count = static_cast<unsigned int>(table->get_pieces().size());
+		std::copy(table->get_pieces().begin(), table->get_pieces().end(), pos.pieces.begin());
+		bool flipped;
+		std::string name = tablebase_class(pos, flipped);
+		if (name == "KK" || set.find(name)) {
+			return true;
+		}
+		if (flipped) {
+			return build(name);
+		}
+
+		if (table->load(directory) && table->has_dtm()) {
+			std::cout << name << ": read from " << tablebase_path(directory, name, ".dtm") << std::endl;
+		}
+		else {
+			for (const std::string& child : table->child_classes()) {
+				if (!build(child)) { return false; }
+			}
+			auto start = std::chrono::steady_clock::now();
+			table->generate(set, threads);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			size_t won = 0, drawn = 0, lost = 0;
+			int longest = 0;
+			for (size_t i = 0; i < table->size(); ++i) {
+				TbResult result;
+				if (!table->probe(i, result)) { continue; }
+				(result.wdl > 0 ? won : result.wdl < 0 ? lost : drawn)++;
+				longest = std::max(longest, result.plies);
+			}
+			std::cout << name << ": " << won << " won, " << drawn << " drawn, " << lost << " lost, longest mate " << longest
+				<< " plies, " << seconds << " s on " << threads << " threads" << std::endl;
+			if (!table->write(directory)) {
+				std::cerr << "could not write " << tablebase_path(directory, name, ".dtm") << std::endl;
+				return false;
+			}
+		}
+
+		const Tablebase* added = table.get();
+		set.add(std::move(table));
+		if (samples > 0) {
+			size_t wrong = verify_tablebase(*added, set, samples);
+			std::cout << name << ": " << samples << " positions verified, " << wrong << " wrong" << std::endl;
+			failures += wrong;
+		}
+		return true;
+	};
+
+	for (const std::string& material : wanted) {
+		if (!build(material)) { return 2; }
+	}
+	return failures > 0 ? 1 : 0;
+}
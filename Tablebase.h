@@ -0,0 +1,119 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <memory>
+#include <cstddef>
+#include "stdint.h"
+#include "Colors.h"
+#include "Types.h"
+#include "Position.h"
+#include "MappedFile.h"
+
+const unsigned int TB_MAX_PIECES = 4; // kings included
+
+// The result for the side to move with best play by both sides. Tables know nothing of castling, en passant or the fifty
+// move rule, so a mate may lie further away than fifty moves.
+struct TbResult {
+	int wdl; // 1 win, 0 draw, -1 loss
+	int plies; // plies to mate: odd for a win, even for a loss (0 is checkmated). -1 for a draw, or when only the WDL file is loaded
+};
+
+struct TbPiece {
+	Colors color;
+	Types type;
+};
+
+// A position with only a few pieces, as the tables see it
+struct TbPosition {
+	std::array<TbPiece, TB_MAX_PIECES> pieces;
+	std::array<unsigned int, TB_MAX_PIECES> squares; // square index of each piece
+	unsigned int count;
+	Colors turn;
+};
+
+// Squares of a material class's pieces, in the class's own piece order
+struct TbBoard {
+	std::array<uint8_t, TB_MAX_PIECES> squares;
+	Colors turn;
+};
+
+class Tablebases;
+
+// One material class, e.g. KRKP: white has the pieces between the kings, black those after the second king. Every position
+// of the class has an index; positions that are mirror images of each other share one, so the white king only ever stands on
+// the a8-d8-d5 triangle (10 squares), or with pawns on the board, where only the left-right mirror holds, on files a-d (32).
+//
+// Each index holds one byte: 0 a draw, 1-127 a win in that many moves, 128 + n a loss in n moves, 255 a position that is
+// illegal or not the chosen image of its mirror group. The .dtm file is a header followed by those bytes, the .wdl file the
+// same header followed by 2 bits per index (0 draw, 1 win, 2 loss, 3 illegal), four indices to a byte from the low bits.
+class Tablebase {
+private:
+	std::string name;
+	std::vector<TbPiece> pieces; // [0] the white king, [1] the black king, then white's pieces and black's, from queen to pawn
+	bool pawns;
+	size_t half_size; // indices with one side to move; white to move comes first
+	std::vector<uint8_t> generated; // filled in by generate, empty for a table read from a file
+	MappedFile file;
+	const uint8_t* data;
+	bool dtm; // data is DTM bytes rather than WDL fields
+
+	void unpack(size_t index, TbBoard& board) const;
+	unsigned int children(const TbBoard& board, const Tablebases& others, TbResult* results) const;
+	void predecessors(const TbBoard& board, std::vector<uint32_t>& found) const;
+
+public:
+	Tablebase() : pawns(false), half_size(0), data(nullptr), dtm(true) {}
+	Tablebase(const Tablebase&) = delete;
+	Tablebase& operator=(const Tablebase&) = delete;
+
+	bool set_material(const std::string& material); // false if the name is not a class of at most TB_MAX_PIECES pieces
+	const std::string& get_name() const { return name; }
+	const std::vector<TbPiece>& get_pieces() const { return pieces; }
+	size_t size() const { return 2 * half_size; }
+	bool has_dtm() const { return dtm; }
+
+	size_t index(const TbBoard& board) const; // the index of the board or of its chosen mirror image
+	bool decode(size_t index, TbBoard& board) const; // false for an index that is not a legal chosen image
+	bool probe(size_t index, TbResult& result) const; // false for an illegal index
+
+	std::vector<std::string> child_classes() const; // the classes captures and promotions lead to, KK included
+	bool generate(const Tablebases& others, unsigned int threads); // false if a class in child_classes is missing from others
+	bool write(const std::string& directory) const; // both the .dtm and the .wdl file
+	bool load(const std::string& directory); // the .dtm file if there is one, otherwise the .wdl file
+};
+
+// Every class of up to TB_MAX_PIECES pieces a set may hold, named with the stronger side as white, as the files are
+std::vector<std::string> tablebase_classes();
+
+// The name of the class holding these pieces, and whether its colors are the other way round from the position's
+std::string tablebase_class(const TbPosition& pos, bool& flipped);
+
+class Tablebases {
+private:
+	std::map<std::string, std::unique_ptr<Tablebase>> tables;
+	unsigned int max_pieces;
+
+public:
+	Tablebases() : max_pieces(0) {}
+
+	void add(std::unique_ptr<Tablebase> table);
+	const Tablebase* find(const std::string& name) const;
+	size_t size() const { return tables.size(); }
+	unsigned int get_max_pieces() const { return max_pieces; }
+
+	bool probe(const TbPosition& pos, TbResult& result) const; // false if the class is not in the set. Two bare kings are always a draw
+};
+
+unsigned int load_tablebases(const std::string& directory); // loads every table found in the directory, returns how many
+unsigned int tablebase_pieces(); // the most pieces of any loaded table, 0 when none are loaded
+bool probe_tablebase(Position& pos, TbResult& result); // false if the position has castling rights, a possible en passant capture or no loaded table
+
+// tb-gen <directory> [threads <n>] [verify <samples>] [<class> ...]
+// Generates the named classes (all of them when none are named) and every class they convert into by captures and
+// promotions, and writes their .dtm and .wdl files. Tables already in the directory are read rather than generated again.
+// verify sets up that many random positions of each class, plays every legal move with make_move and checks the table
+// against the results the moves lead to.
+int tbgen_main(int argc, char* argv[]);
@@ -0,0 +1,67 @@
+#include "TimeManager.h"
+#include "Search.h"
+#include <algorithm>
+
+void TimeManager::init(const SearchLimits& limits, Colors turn) {
+	start = std::chrono::steady_clock::now();
+	soft_limit = hard_limit = 0;
+	adjustable = false;
+	last_best = Move();
+	stable_iterations = 0;
+	last_score = 0;
+	score_drop = 0;
+
+	if (limits.infinite) {
+		return;
+	}
+	if (limits.movetime != 0) {
+		soft_limit = hard_limit = std::max<int64_t>(1, limits.movetime - MOVE_OVERHEAD);
+		return;
+	}
+	if (limits.time[turn] <= 0) {
+		return;
+	}
+
+	int64_t left = std::max<int64_t>(1, limits.time[turn] - MOVE_OVERHEAD);
+	int moves_to_go = (limits.movestogo > 0) ? std::min(limits.movestogo, DEFAULT_MOVES_TO_GO) : DEFAULT_MOVES_TO_GO;
+
+	// spend an even share of what is left, plus most of the increment; never more than a few shares or most of the clock on one move
+	soft_limit = left / moves_to_go + limits.increment[turn] * 3 / 4;
+	hard_limit = std::min(soft_limit * 4, left * 3 / 4);
+	soft_limit = std::max<int64_t>(1, std::min(soft_limit, hard_limit));
+	hard_limit = std::max<int64_t>(1, hard_limit);
+	adjustable = true;
+}
+
+int64_t TimeManager::elapsed() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start.load()).count();
+}
+
+void TimeManager::update(int depth, Move best_move, int score) {
+	if (depth > 1 && best_move == last_best) {
+		++stable_iterations;
+	}
+	else {
+		stable_iterations = 0;
+	}
+	score_drop = (depth > 1) ? std::max(0, last_score - score) : 0;
+	last_best = best_move;
+	last_score = score;
+}
+
+bool TimeManager::stop_iterating() {
+	if (soft_limit == 0) {
+		return false;
+	}
+	if (!adjustable) {
+		return elapsed() >= soft_limit;
+	}
+
+	// from 1.25x the soft limit right after the best move changed, down to 0.65x once it has held for six iterations
+	double stability = 1.25 - 0.1 * std::min(stable_iterations, 6);
+	// up to 2x when the score fell by a pawn or more
+	double drop = 1.0 + std::min(score_drop, 100) / 100.0;
+
+	int64_t target = std::min(hard_limit, int64_t(soft_limit * stability * drop));
+	return elapsed() >= target;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include "stdint.h"
+#include "Move.h"
+#include "Colors.h"
+
+struct SearchLimits;
+
+// Decides how long to think about a move.
+//
+// The hard limit is checked inside the search and ends it wherever it is. The soft limit is only checked between iterations
+// of iterative deepening: it shrinks while the best move stays the same from one iteration to the next, and grows (up to the
+// hard limit) when the score drops, since that is when a deeper search is most likely to change the move.
+class TimeManager {
+private:
+	static const int64_t MOVE_OVERHEAD = 30; // milliseconds kept back for the GUI and the operating system
+	static const int DEFAULT_MOVES_TO_GO = 30; // sudden death is treated as if this many moves were left
+
+	std::atomic<std::chrono::steady_clock::time_point> start; // moved by ponderhit() from another thread while the search runs
+	int64_t soft_limit; // milliseconds, 0 is no limit
+	int64_t hard_limit;
+	bool adjustable; // false for a fixed movetime
+	Move last_best;
+	int stable_iterations; // completed iterations in a row that kept the same best move
+	int last_score;
+	int score_drop; // how far the score fell in the last iteration, 0 if it did not
+
+public:
+	TimeManager() : soft_limit(0), hard_limit(0), adjustable(false), stable_iterations(0), last_score(0), score_drop(0) {}
+
+	void init(const SearchLimits& limits, Colors turn);
+	void ponderhit() { start = std::chrono::steady_clock::now(); } // a ponder search only starts using its own clock now
+	int64_t elapsed();
+	bool hard_limit_reached() { return hard_limit != 0 && elapsed() >= hard_limit; }
+	void update(int depth, Move best_move, int score);
+	bool stop_iterating(); // whether to finish after the iteration that just completed
+	int64_t get_soft_limit() { return soft_limit; }
+	int64_t get_hard_limit() { return hard_limit; }
+};
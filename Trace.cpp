@@ -0,0 +1,70 @@
+#include "Trace.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+
+// Buffers are never freed, so the spans of threads that have already finished can still be written out.
+std::mutex trace_mutex;
+std::vector<std::unique_ptr<TraceBuffer>> trace_buffers;
+const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+int64_t trace_now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_epoch).count();
+}
+
+TraceBuffer& thread_trace_buffer() {
+	thread_local TraceBuffer* buffer = nullptr;
+	if (!buffer) {
+		std::lock_guard<std::mutex> lock(trace_mutex);
+		trace_buffers.emplace_back(new TraceBuffer());
+		buffer = trace_buffers.back().get();
+		buffer->recorded = 0;
+		buffer->thread_id = static_cast<unsigned int>(trace_buffers.size());
+	}
+	return *buffer;
+}
+
+void trace_clear() {
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	for (auto& buffer : trace_buffers) {
+		buffer->recorded = 0;
+	}
+}
+
+// Complete ("X") events with microsecond timestamps, as the trace event format expects, plus a name for every thread.
+void write_chrome_trace(std::ostream& out) {
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	bool first = true;
+
+	out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+	for (auto& buffer : trace_buffers) {
+		out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->thread_id
+			<< ", \"args\": {\"name\": \"thread " << buffer->thread_id << "\"}}";
+		first = false;
+
+		uint64_t count = std::min<uint64_t>(buffer->recorded, TraceBuffer::CAPACITY);
+		for (uint64_t i = buffer->recorded - count; i < buffer->recorded; ++i) {
+			TraceEvent& event = buffer->events[i % TraceBuffer::CAPACITY];
+			out << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->thread_id
+				<< ", \"ts\": " << event.start_ns / 1000 << "." << (event.start_ns % 1000) / 100
+				<< ", \"dur\": " << event.duration_ns / 1000 << "." << (event.duration_ns % 1000) / 100;
+			if (event.arg >= 0) {
+				out << ", \"args\": {\"value\": " << event.arg << "}";
+			}
+			out << "}";
+		}
+	}
+	out << "\n]}\n";
+}
+
+bool write_chrome_trace(const std::string& path) {
+	std::ofstream file(path);
+	if (!file) {
+		return false;
+	}
+	write_chrome_trace(file);
+	return bool(file);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <ostream>
+#include "stdint.h"
+
+// Scoped timing spans, compiled in only when ENABLE_TRACE is defined (TRACE_SPAN expands to nothing otherwise).
+//
+// Each span records its name, start and duration when it goes out of scope, into a ring buffer owned by the current thread,
+// so recording never takes a lock. When a buffer is full the oldest spans are overwritten. write_chrome_trace() turns every
+// buffer into a Chrome / Perfetto JSON trace with one timeline per thread; it should only be called while no thread is
+// recording, e.g. between searches.
+struct TraceEvent {
+	const char* name; // must be a string literal, only the pointer is kept
+	int64_t start_ns; // since the first span recorded by the process
+	int64_t duration_ns;
+	int64_t arg; // shown as args.value in the trace viewer, -1 for none
+};
+
+struct TraceBuffer {
+	static const size_t CAPACITY = 1 << 16; // events per thread
+
+	std::array<TraceEvent, CAPACITY> events;
+	uint64_t recorded; // total ever recorded, the newest is at (recorded - 1) % CAPACITY
+	unsigned int thread_id; // order in which threads first recorded a span, for the trace's tid
+
+	void record(const char* name, int64_t start_ns, int64_t duration_ns, int64_t arg) {
+		events[recorded % CAPACITY] = { name, start_ns, duration_ns, arg };
+		++recorded;
+	}
+};
+
+TraceBuffer& thread_trace_buffer(); // this thread's buffer, registered on first use
+int64_t trace_now_ns();
+void trace_clear();
+void write_chrome_trace(std::ostream& out);
+bool write_chrome_trace(const std::string& path);
+
+class TraceSpan {
+private:
+	const char* name;
+	int64_t start_ns;
+	int64_t arg;
+
+public:
+	TraceSpan(const char* name, int64_t arg = -1) : name(name), start_ns(trace_now_ns()), arg(arg) {}
+	~TraceSpan() { thread_trace_buffer().record(name, start_ns, trace_now_ns() - start_ns, arg); }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#ifdef ENABLE_TRACE
+const bool TRACE_ENABLED = true;
+#define TRACE_SPAN(...) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+#else
+const bool TRACE_ENABLED = false;
+#define TRACE_SPAN(...) ((void)0)
+#endif
@@ -0,0 +1,82 @@
+#include "TranspositionTable.h"
+#include "Stats.h"
+#include "Trace.h"
+#include <algorithm>
+
+Move TTEntry::get_move(Colors turn) {
+	Move move(Square(static_cast<unsigned int>(from)), Square(static_cast<unsigned int>(to)), turn, static_cast<Types>(type));
+	return move.set_promote_type(static_cast<Types>(promote_type));
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes) {
+	resize(megabytes);
+}
+
+void TranspositionTable::resize(size_t megabytes) {
+	size_t count = std::max<size_t>(megabytes, 1) * 1024 * 1024 / sizeof(TTEntry);
+	size_t size = 1;
+	while (size * 2 <= count) { size *= 2; }
+
+	entries.assign(size, TTEntry());
+	entries.shrink_to_fit();
+	mask = size - 1;
+	clear();
+}
+
+void TranspositionTable::clear() {
+	for (auto& entry : entries) {
+		entry = TTEntry();
+		entry.bound = BOUND_NONE;
+	}
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) {
+	TRACE_SPAN("tt_probe");
+	TTEntry& slot = entries[key & mask];
+	STAT_INC(STAT_TT_PROBES);
+	if (slot.bound == BOUND_NONE || slot.key != key) {
+		return false;
+	}
+	STAT_INC(STAT_TT_HITS);
+	entry = slot;
+	return true;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, int score, Bounds bound, Move move) {
+	TRACE_SPAN("tt_store");
+	TTEntry& slot = entries[key & mask];
+
+	// keep a deeper result for the same position, unless the new one is exact
+	if (slot.bound != BOUND_NONE && slot.key == key && slot.depth > depth && bound != BOUND_EXACT) {
+		return;
+	}
+
+	// a search that found no best move (every move failed low) should not erase the one already stored
+	if (move.is_null() && slot.key == key && slot.has_move()) {
+		move = slot.get_move(move.get_color());
+	}
+
+	slot.key = key;
+	slot.score = static_cast<int16_t>(score);
+	slot.depth = static_cast<uint8_t>(std::max(depth, 0));
+	slot.bound = static_cast<uint8_t>(bound);
+	if (move.is_null()) {
+		slot.from = slot.to = 0;
+		slot.type = slot.promote_type = static_cast<int8_t>(NONE);
+	}
+	else {
+		slot.from = static_cast<uint8_t>(move.get_from().convert_to_index());
+		slot.to = static_cast<uint8_t>(move.get_to().convert_to_index());
+		slot.type = static_cast<int8_t>(move.get_type());
+		slot.promote_type = static_cast<int8_t>(move.get_promote_type());
+	}
+}
+
+int TranspositionTable::hashfull() {
+	size_t sample = std::min<size_t>(1000, entries.size());
+	int used = 0;
+	for (size_t i = 0; i < sample; ++i) {
+		used += entries[i].bound != BOUND_NONE;
+	}
+	return int(used * 1000 / sample);
+}
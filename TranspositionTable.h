@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include "stdint.h"
+#include "Move.h"
+
+enum Bounds { BOUND_NONE = 0, BOUND_UPPER = 1, BOUND_LOWER = 2, BOUND_EXACT = 3 };
+
+// One search result, packed into 16 bytes. The best move is kept as squares and piece types only,
+// which is enough to find it again among the generated moves.
+struct TTEntry {
+	uint64_t key;
+	int16_t score;
+	uint8_t depth;
+	uint8_t bound;
+	uint8_t from; // square indices of the best move, from == to when there is none
+	uint8_t to;
+	int8_t type;
+	int8_t promote_type;
+
+	bool has_move() { return from != to; }
+	Move get_move(Colors turn);
+};
+
+// Search results keyed by the position's Zobrist key. One entry per slot, replaced unless it holds a deeper result
+// for the same position. Sized in megabytes, rounded down to a power of two number of entries.
+class TranspositionTable {
+private:
+	std::vector<TTEntry> entries;
+	uint64_t mask;
+
+public:
+	TranspositionTable(size_t megabytes = 16);
+
+	void resize(size_t megabytes);
+	void clear();
+	bool probe(uint64_t key, TTEntry& entry);
+	void store(uint64_t key, int depth, int score, Bounds bound, Move move);
+	int hashfull(); // permille of the first thousand slots in use
+};
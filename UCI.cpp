@@ -0,0 +1,321 @@
+#include "UCI.h"
+#include "Perft.h"
+#include "Stats.h"
+#include "Trace.h"
+#include <iostream>
+#include <chrono>
+#include <cctype>
+
+const size_t MAX_HASH_MB = 4096;
+const int MAX_THREADS = 256;
+
+// Mate scores are reported in moves rather than plies, negative when the engine is getting mated.
+std::string score_to_uci(int score) {
+	if (score >= MATE_BOUND) {
+		return "mate " + std::to_string((MATE_SCORE - score + 1) / 2);
+	}
+	if (score <= -MATE_BOUND) {
+		return "mate -" + std::to_string((MATE_SCORE + score) / 2);
+	}
+	return "cp " + std::to_string(score);
+}
+
+Uci::Uci() : pos(START_FEN), search(pos), hash_mb(16), threads(1), own_book(false) {
+	search.set_reporter([this](SearchIteration& iteration) {
+		int64_t ms = int64_t(iteration.seconds * 1000);
+		std::string line = "info depth " + std::to_string(iteration.depth)
+			+ " score " + score_to_uci(iteration.score)
+			+ " nodes " + std::to_string(iteration.nodes)
+			+ " nps " + std::to_string(ms > 0 ? iteration.nodes * 1000 / ms : iteration.nodes)
+			+ " time " + std::to_string(ms)
+			+ " hashfull " + std::to_string(search.get_tt().hashfull())
+			+ " pv";
+		for (auto& move : iteration.pv) {
+			line += " " + move_to_uci(move);
+		}
+		send(line);
+	});
+}
+
+Uci::~Uci() {
+	stop_search();
+}
+
+void Uci::send(const std::string& line) {
+	std::lock_guard<std::mutex> lock(output_mutex);
+	std::cout << line << std::endl;
+}
+
+void Uci::loop(std::istream& in) {
+	std::string line, command;
+
+	while (std::getline(in, line)) {
+		std::istringstream args(line);
+		command.clear();
+		args >> command;
+
+		if (command == "uci") {
+			handle_uci();
+		}
+		else if (command == "isready") {
+			send("readyok");
+		}
+		else if (command == "setoption") {
+			stop_search();
+			handle_setoption(args);
+		}
+		else if (command == "ucinewgame") {
+			stop_search();
+			search.clear();
+		}
+		else if (command == "position") {
+			stop_search();
+			handle_position(args);
+		}
+		else if (command == "go") {
+			stop_search();
+			handle_go(args);
+		}
+		else if (command == "stop") {
+			stop_search();
+		}
+		else if (command == "ponderhit") {
+			search.ponderhit();
+		}
+		else if (command == "quit") {
+			break;
+		}
+		else if (command == "d") { // not part of the protocol, handy when debugging by hand
+			pos.disp();
+			send("Fen: " + pos.to_fen());
+		}
+		else if (command == "stats") { // counters since the last go, only counted in builds with ENABLE_STATS
+			send("info string stats " + stats_json(stats_snapshot()));
+		}
+		else if (command == "trace") { // trace save <file.json> | trace clear, spans are only recorded in builds with ENABLE_TRACE
+			stop_search();
+			handle_trace(args);
+		}
+		else if (command == "perft") { // perft [divide] <depth>, on the current position, also not part of the protocol
+			stop_search();
+			handle_perft(args);
+		}
+		else if (!command.empty()) {
+			send("info string unknown command " + command);
+		}
+	}
+	stop_search();
+}
+
+void Uci::handle_uci() {
+	send("id name Chess Engine");
+	send("id author Chess Engine developers");
+	send("option name Hash type spin default 16 min 1 max " + std::to_string(MAX_HASH_MB));
+	send("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+	send("option name Ponder type check default false");
+	send("option name EvalFile type string default <empty>");
+	send("option name OwnBook type check default false");
+	send("option name BookFile type string default <empty>");
+	send("option name TablebasePath type string default <empty>");
+	send("uciok");
+}
+
+// setoption name <id> [value <x>], where both the name and the value may contain spaces
+void Uci::handle_setoption(std::istringstream& args) {
+	std::string token, name, value;
+	bool reading_value = false;
+
+	args >> token; // "name"
+	while (args >> token) {
+		if (token == "value") {
+			reading_value = true;
+		}
+		else if (reading_value) {
+			value += (value.empty() ? "" : " ") + token;
+		}
+		else {
+			name += (name.empty() ? "" : " ") + token;
+		}
+	}
+
+	if (name == "Hash") {
+		size_t mb;
+		if (!parse_number(value, mb)) {
+			send("info string invalid value " + value + " for Hash");
+			return;
+		}
+		hash_mb = std::max<size_t>(1, std::min<size_t>(mb, MAX_HASH_MB));
+		search.get_tt().resize(hash_mb);
+	}
+	else if (name == "Threads") {
+		int count;
+		if (!parse_number(value, count)) {
+			send("info string invalid value " + value + " for Threads");
+			return;
+		}
+		threads = std::max(1, std::min(count, MAX_THREADS));
+	}
+	else if (name == "Ponder") {
+		// nothing to set up, the GUI decides when to send go ponder
+	}
+	else if (name == "EvalFile") {
+		if (load_network(value)) {
+			send("info string loaded network " + value);
+		}
+		else {
+			send("info string could not load network " + value + ", using the classical evaluation");
+		}
+		search.set_position(pos);
+	}
+	else if (name == "OwnBook") {
+		own_book = (value == "true");
+	}
+	else if (name == "BookFile") {
+		if (book.open(value)) {
+			send("info string loaded book " + value + " with " + std::to_string(book.size()) + " entries");
+		}
+		else {
+			send("info string could not load book " + value);
+		}
+	}
+	else if (name == "TablebasePath") {
+		unsigned int count = load_tablebases(value);
+		send("info string loaded " + std::to_string(count) + " tablebases from " + value);
+	}
+	else {
+		send("info string unknown option " + name);
+	}
+}
+
+// position [startpos | fen <fen>] [moves <move> ...]
+void Uci::handle_position(std::istringstream& args) {
+	std::string token, fen;
+
+	args >> token;
+	if (token == "startpos") {
+		fen = START_FEN;
+		args >> token; // "moves", if there are any
+	}
+	else if (token == "fen") {
+		while (args >> token && token != "moves") {
+			fen += (fen.empty() ? "" : " ") + token;
+		}
+	}
+	else {
+		return;
+	}
+
+	if (FenErrors error = pos.parse_fen(fen)) {
+		send("info string invalid fen: " + std::string(fen_error_message(error)));
+		return;
+	}
+
+	Move move;
+	while (args >> token) {
+		if (!parse_uci_move(pos, token, move)) {
+			send("info string illegal move " + token);
+			break;
+		}
+		pos.make_move(move);
+	}
+	search.set_position(pos);
+}
+
+void Uci::handle_perft(std::istringstream& args) {
+	std::string token;
+	unsigned int depth = 0;
+	bool divide = false;
+
+	while (args >> token) {
+		if (token == "divide") { divide = true; }
+		else if (!parse_number(token, depth)) {
+			send("info string invalid value " + token + " for perft depth");
+			return;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<DivideEntry> entries = perft_divide(pos, depth, threads);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::ostringstream out;
+	if (divide) {
+		print_divide(entries, seconds, out);
+	}
+	else {
+		uint64_t nodes = (depth == 0) ? 1 : 0;
+		for (auto& entry : entries) { nodes += entry.nodes; }
+		out << "nodes " << nodes << " time " << int64_t(seconds * 1000) << " nps " << uint64_t(seconds > 0 ? nodes / seconds : 0);
+	}
+	send(out.str());
+}
+
+void Uci::handle_trace(std::istringstream& args) {
+	std::string action, path;
+	args >> action >> path;
+
+	if (action == "clear") {
+		trace_clear();
+	}
+	else if (action == "save" && !path.empty()) {
+		send(write_chrome_trace(path) ? "info string trace written to " + path : "info string could not write " + path);
+	}
+}
+
+void Uci::handle_go(std::istringstream& args) {
+	SearchLimits limits;
+	std::string token;
+
+	while (args >> token) {
+		if (token == "depth") { args >> limits.depth; }
+		else if (token == "nodes") { args >> limits.nodes; }
+		else if (token == "movetime") { args >> limits.movetime; }
+		else if (token == "wtime") { args >> limits.time[WHITE]; }
+		else if (token == "btime") { args >> limits.time[BLACK]; }
+		else if (token == "winc") { args >> limits.increment[WHITE]; }
+		else if (token == "binc") { args >> limits.increment[BLACK]; }
+		else if (token == "movestogo") { args >> limits.movestogo; }
+		else if (token == "mate") { int moves; args >> moves; limits.depth = 2 * moves; }
+		else if (token == "infinite") { limits.infinite = true; }
+		else if (token == "ponder") { limits.ponder = true; }
+	}
+	limits.depth = std::max(1, std::min(limits.depth, MAX_PLY - 1));
+
+	// a book move is played straight away, except when the GUI wants the engine thinking until it says stop
+	Move book_move;
+	if (own_book && !limits.infinite && !limits.ponder && book.pick_move(pos, book_move)) {
+		send("info string book move");
+		send("bestmove " + move_to_uci(book_move));
+		return;
+	}
+
+	search.reset_signals(limits.ponder);
+	stats_reset();
+	worker = std::thread(&Uci::run_search, this, limits);
+}
+
+void Uci::run_search(SearchLimits limits) {
+	SearchResult result = search.think(limits);
+
+	// bestmove must not be sent while pondering or in an infinite search, even if the search has already finished
+	while ((limits.infinite || search.is_pondering()) && !search.is_stop_requested()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	if (STATS_ENABLED) {
+		send("info string stats " + stats_json(stats_snapshot()));
+	}
+
+	std::string line = "bestmove " + move_to_uci(result.best_move);
+	if (result.pv.size() >= 2 && result.pv[0] == result.best_move) {
+		line += " ponder " + move_to_uci(result.pv[1]);
+	}
+	send(line);
+}
+
+void Uci::stop_search() {
+	if (worker.joinable()) {
+		search.stop();
+		worker.join();
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include "Position.h"
+#include "Search.h"
+#include "Notation.h"
+#include "Polyglot.h"
+#include "Tablebase.h"
+
+// Universal Chess Interface front end. Commands are read on the calling thread while the search runs on a worker thread,
+// so that stop, ponderhit and isready are answered straight away.
+class Uci {
+private:
+	Position pos;
+	Search search;
+	std::thread worker;
+	std::mutex output_mutex;
+	size_t hash_mb;
+	int threads; // used by perft, the search itself is single threaded for now
+	PolyglotBook book;
+	bool own_book; // answer go from the book while it has moves for the position
+
+	void handle_uci();
+	void handle_setoption(std::istringstream& args);
+	void handle_position(std::istringstream& args);
+	void handle_go(std::istringstream& args);
+	void handle_perft(std::istringstream& args);
+	void handle_trace(std::istringstream& args);
+	void run_search(SearchLimits limits);
+	void stop_search();
+	void send(const std::string& line);
+
+public:
+	Uci();
+	~Uci();
+
+	void loop(std::istream& in);
+};
@@ -1,4 +1,14 @@
 #pragma once
 #include "assert.h"
+#include <string>
+#include <charconv>
 
 #define ASSERT_ONE_SQUARE(square) (assert(std::bitset<64>((square).get_u64()).count() == 1))
+
+// False unless the whole of text is a number in range; std::stoi would throw on bad input and ignore trailing junk.
+template <typename T>
+bool parse_number(const std::string& text, T& number) {
+	const char* end = text.data() + text.size();
+	auto [ptr, error] = std::from_chars(text.data(), end, number);
+	return error == std::errc() && ptr == end;
+}
@@ -0,0 +1,75 @@
+#include "Zobrist.h"
+#include "Types.h"
+#include "Attacks.h"
+#include <utility>
+#include <algorithm>
+#include <cstdlib>
+
+// xorshift64* with a fixed seed, so keys (and anything stored by key) are the same on every run
+uint64_t next_random(uint64_t& state) {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545F4914F6CDD1DULL;
+}
+
+Zobrist::Zobrist() {
+	uint64_t state = 0x9E3779B97F4A7C15ULL;
+	for (auto& by_type : pieces) {
+		for (auto& by_square : by_type) {
+			for (auto& key : by_square) {
+				key = next_random(state);
+			}
+		}
+	}
+	for (auto& key : castling) { key = next_random(state); }
+	for (auto& key : ep_file) { key = next_random(state); }
+	black_to_move = next_random(state);
+}
+
+const Zobrist zobrist;
+
+Cuckoo::Cuckoo() {
+	moves.fill(CuckooMove{ 0, 0, { 0, 0 } });
+	for (int color = 0; color < 2; ++color) {
+		for (int type = KNIGHT; type <= KING; ++type) {
+			for (int from = 0; from < 64; ++from) {
+				for (int to = from + 1; to < 64; ++to) {
+					int rows = to / 8 - from / 8, files = to % 8 - from % 8;
+					int drow = std::abs(rows), dfile = std::abs(files);
+					bool diagonal = drow == dfile, straight = drow == 0 || dfile == 0;
+					bool reaches = (type == KNIGHT && drow * dfile == 2) || (type == BISHOP && diagonal) || (type == ROOK && straight)
+						|| (type == QUEEN && (diagonal || straight)) || (type == KING && std::max(drow, dfile) == 1);
+					if (!reaches) {
+						continue;
+					}
+
+					CuckooMove move{ zobrist.pieces[color][type][from] ^ zobrist.pieces[color][type][to] ^ zobrist.black_to_move,
+						type == KNIGHT ? 0 : squares_between(from, to), { static_cast<uint8_t>(from), static_cast<uint8_t>(to) } };
+
+					// place the move, pushing whatever held the slot over to its other slot, until an empty one is reached
+					size_t slot = first_slot(move.key);
+					while (true) {
+						std::swap(moves[slot], move);
+						if (move.key == 0) {
+							break;
+						}
+						slot = (slot == first_slot(move.key)) ? second_slot(move.key) : first_slot(move.key);
+					}
+				}
+			}
+		}
+	}
+}
+
+const CuckooMove* Cuckoo::find(uint64_t key) const {
+	const CuckooMove* move = &moves[first_slot(key)];
+	if (move->key == key) {
+		return move;
+	}
+	move = &moves[second_slot(key)];
+	return move->key == key ? move : nullptr;
+}
+
+// after zobrist, which it is built from
+const Cuckoo cuckoo;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include "stdint.h"
+
+// Random keys for Zobrist hashing. A position's key is the XOR of the keys for everything in it, so make_move can update it
+// by XOR-ing out what changed and XOR-ing in the replacement.
+struct Zobrist {
+	std::array<std::array<std::array<uint64_t, 64>, 6>, 2> pieces; // indexed [color][type][square index]
+	std::array<uint64_t, 16> castling; // indexed by the four castling right bits of Position::flags
+	std::array<uint64_t, 8> ep_file; // only the file is needed, the rank follows from the side to move
+	uint64_t black_to_move;
+
+	Zobrist();
+};
+
+extern const Zobrist zobrist;
+
+const size_t CUCKOO_SIZE = 8192; // a power of two, comfortably more than the 3668 moves it holds
+
+struct CuckooMove {
+	uint64_t key; // the two squares' keys for the piece and the side to move key XOR-ed together, 0 for an empty slot
+	uint64_t between; // squares strictly between the two, which must be empty for the move to be possible
+	uint8_t squares[2]; // square indices, the move goes either way
+};
+
+// Every move a knight, bishop, rook, queen or king of either color can make on an empty board, filed by the change it makes to
+// the key. Such moves are reversible, so XOR-ing a position's key with an earlier one and finding the result here shows that a
+// single move joins the two positions. Cuckoo hashing keeps every move in one of two slots, so a lookup is two reads.
+struct Cuckoo {
+	std::array<CuckooMove, CUCKOO_SIZE> moves;
+
+	static size_t first_slot(uint64_t key) { return key & (CUCKOO_SIZE - 1); }
+	static size_t second_slot(uint64_t key) { return (key >> 16) & (CUCKOO_SIZE - 1); }
+	const CuckooMove* find(uint64_t key) const; // nullptr if no move makes this change
+
+	Cuckoo();
+};
+
+extern const Cuckoo cuckoo;